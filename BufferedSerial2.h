@@ -25,10 +25,26 @@
 #define BUFFEREDSERIAL2_H
 
 #include "mbed_version.h"
+
+// core_util_atomic_load/store_*() arrived in Mbed OS 5.12, rtos::EventFlags in 5.8. Mbed 2 has neither
+#if (MBED_MAJOR_VERSION == 5) && (MBED_MINOR_VERSION >= 12)
+#else
+#error "BufferedSerial2 requires use of Mbed OS 5.12.0 and newer. Use BufferedSerial version 12 and older or upgrade the Mbed version."
+#endif
+
 #include "RawSerial.h"
 #include "Stream.h"
 #include "NonCopyable.h"
+#include "Timeout.h"
 #include "CircularBuffer2.h"
+#include "CycleCounter.h"
+#include "LatencyHistogram.h"
+#include "CriticalSectionTrace.h"
+#include <stdio.h>
+#include <stdarg.h>
+#if MBED_CONF_RTOS_PRESENT
+#include "rtos/EventFlags.h"
+#endif
 
 #if !defined(BUFFEREDSERIAL2_TX_SIZE)
 #define BUFFEREDSERIAL2_TX_SIZE 0x200
@@ -38,12 +54,100 @@
 #define BUFFEREDSERIAL2_RX_SIZE 0x100
 #endif
 
-#if (MBED_MAJOR_VERSION == 5) && (MBED_MINOR_VERSION >= 2)
-#elif (MBED_MAJOR_VERSION == 2) && (MBED_PATCH_VERSION > 130)
-#else
-#error "BufferedSerial version 13 and newer requires use of Mbed OS 5.2.0 and newer or Mbed 2 version 130 and newer. Use BufferedSerial version 12 and older or upgrade the Mbed version."
+// Lock-free rings: only one thread may write and one thread may read a given port
+#if !defined(BUFFEREDSERIAL2_LOCK_FREE)
+#define BUFFEREDSERIAL2_LOCK_FREE 0
+#endif
+
+// Lock the rings by masking only interrupts at this NVIC priority and below (BASEPRI), 0 masks all.
+// Set it to the priority of the UART interrupt, and of the DMA completion interrupt with BUFFEREDSERIAL2_*_DMA
+#if !defined(BUFFEREDSERIAL2_LOCK_PRIORITY)
+#define BUFFEREDSERIAL2_LOCK_PRIORITY 0
+#endif
+
+// With BUFFEREDSERIAL2_LOCK_FREE, put producer and consumer indices on separate cache lines of this size (0 packs them)
+#if !defined(BUFFEREDSERIAL2_CACHE_LINE)
+#define BUFFEREDSERIAL2_CACHE_LINE 0
+#endif
+
+// Mask arithmetic for the rings, both buffer sizes must then be powers of two
+#if !defined(BUFFEREDSERIAL2_POWER_OF_TWO)
+#define BUFFEREDSERIAL2_POWER_OF_TWO 0
+#endif
+
+// Rings sized at compile time from BUFFEREDSERIAL2_RX_SIZE/TX_SIZE, every port must use these sizes
+#if !defined(BUFFEREDSERIAL2_FIXED_SIZE)
+#define BUFFEREDSERIAL2_FIXED_SIZE 0
+#endif
+
+// Index type of the rings (uint8_t, uint16_t or uint32_t), must count up to twice the buffer sizes
+#if !defined(BUFFEREDSERIAL2_COUNTER_TYPE)
+#define BUFFEREDSERIAL2_COUNTER_TYPE uint32_t
+#endif
+
+// Send contiguous regions of the tx buffer with serial_tx_asynch (DMA) instead of refilling the FIFO from txIrq
+#if !defined(BUFFEREDSERIAL2_TX_DMA)
+#define BUFFEREDSERIAL2_TX_DMA 0
+#endif
+
+#if BUFFEREDSERIAL2_TX_DMA && !DEVICE_SERIAL_ASYNCH
+#error "BUFFEREDSERIAL2_TX_DMA requires a target with DEVICE_SERIAL_ASYNCH"
+#endif
+
+// Delay before retrying a tx transfer the HAL refused, e.g. when started from the completion of the previous one
+#if !defined(BUFFEREDSERIAL2_TX_DMA_RETRY_US)
+#define BUFFEREDSERIAL2_TX_DMA_RETRY_US 100
+#endif
+
+// Receive straight into the rx buffer with serial_rx_asynch (DMA) instead of one rxIrq per byte
+#if !defined(BUFFEREDSERIAL2_RX_DMA)
+#define BUFFEREDSERIAL2_RX_DMA 0
+#endif
+
+#if BUFFEREDSERIAL2_RX_DMA && !DEVICE_SERIAL_ASYNCH
+#error "BUFFEREDSERIAL2_RX_DMA requires a target with DEVICE_SERIAL_ASYNCH"
+#endif
+
+// Period of the poll that follows a frame arriving by rx DMA. Between frames a single byte
+// transfer waits for the next one, its completion starts a transfer into all free space and
+// the poll, which publishes what _serial.rx_buff.pos shows as received. Once a period passes
+// without a byte the frame is over: the poll ends the transfer and stops. Should be a few byte
+// times at the baud rate in use, and relies on the HAL advancing rx_buff.pos as bytes arrive.
+// 0 disables it, the data is then published when a transfer fills up, when the delimiter of
+// set_rx_notify() arrives, on rx_idle() and when a reader looks
+#if !defined(BUFFEREDSERIAL2_RX_DMA_POLL_US)
+#define BUFFEREDSERIAL2_RX_DMA_POLL_US 1000
+#endif
+
+// Count bytes, interrupts and blocking time per port, see BufferedSerial2::get_stats()
+#if !defined(BUFFEREDSERIAL2_STATS)
+#define BUFFEREDSERIAL2_STATS 0
+#endif
+
+// Measure how long bytes wait in the buffers, see BufferedSerial2::get_rx_latency()
+#if !defined(BUFFEREDSERIAL2_LATENCY)
+#define BUFFEREDSERIAL2_LATENCY 0
+#endif
+
+// Sub-bucket bits of the latency histograms, the percentiles are within 1 / 2^bits
+#if !defined(BUFFEREDSERIAL2_LATENCY_PRECISION)
+#define BUFFEREDSERIAL2_LATENCY_PRECISION 3
+#endif
+
+// Time every critical section of the library per call site, see BufferedSerial2TraceSite
+#if !defined(BUFFEREDSERIAL2_TRACE_MASKING)
+#define BUFFEREDSERIAL2_TRACE_MASKING 0
+#endif
+
+// printf()/vprintf() format straight into the tx buffer instead of going through stdio.
+// Like reserve(), only one thread may then write to a port
+#if !defined(BUFFEREDSERIAL2_FAST_PRINTF)
+#define BUFFEREDSERIAL2_FAST_PRINTF 0
 #endif
 
+// Timeout value for set_tx_timeout() that never gives up
+#define BUFFEREDSERIAL2_WAIT_FOREVER 0xFFFFFFFFu
+
 /** A serial port (UART) for communication with other serial devices
  *
  * Can be used for Full Duplex communication, or Simplex by specifying
@@ -81,20 +185,238 @@
  * @endcode
  */
 
+/** Runtime statistics of a BufferedSerial2 port. Bytes per interrupt is
+ *  rx_bytes / rx_irqs and tx_bytes / tx_irqs. Only the dropped counts are
+ *  kept without BUFFEREDSERIAL2_STATS, the rest read 0. Those need
+ *  CIRCULARBUFFER2_DROPPED, which is on by default
+ */
+struct BufferedSerial2Stats {
+    uint32_t rx_bytes;          /**< Bytes read from the hardware */
+    uint32_t tx_bytes;          /**< Bytes handed to the hardware */
+    uint32_t rx_irqs;           /**< Rx interrupts, or rx DMA completions */
+    uint32_t tx_irqs;           /**< Tx interrupts, or tx DMA completions */
+    uint32_t rx_dropped;        /**< Received bytes lost to a full rx buffer */
+    uint32_t tx_dropped;        /**< Written bytes lost to a full tx buffer */
+    uint32_t rx_errors;         /**< Overrun, framing and parity errors, only reported in DMA rx mode */
+    uint32_t tx_blocked_us;     /**< Time writers spent waiting for room in the tx buffer */
+    uint32_t tx_drain_us;       /**< Time sync() spent waiting for the tx buffer to empty */
+};
+
+/** Buffer sizing report of one BufferedSerial2 buffer, see
+ *  BufferedSerial2::get_rx_sizing(). Collected since construction or the
+ *  last reset_sizing()
+ */
+struct BufferedSerial2Sizing {
+    uint32_t capacity;          /**< Current buffer size */
+    uint32_t high_water;        /**< Most bytes held at once, 0 without CIRCULARBUFFER2_HIGH_WATER */
+    uint32_t dropped;           /**< Bytes lost because the buffer was full */
+    uint32_t recommended;       /**< Smallest size expected to meet the target loss rate, 0 if unknown */
+};
+
+/** Call sites of the critical sections timed with BUFFEREDSERIAL2_TRACE_MASKING,
+ *  read with mbed::CriticalSectionTrace::histogram(). Shared by all ports
+ */
+enum BufferedSerial2TraceSite {
+    BufferedSerial2TraceRxBuffer,       /**< Rx buffer operations, locked rings only */
+    BufferedSerial2TraceTxBuffer,       /**< Tx buffer operations, locked rings only */
+    BufferedSerial2TraceEvents,         /**< Setting and clearing wakeup flags without an RTOS */
+    BufferedSerial2TraceTxDma,          /**< Starting a tx DMA transfer */
+    BufferedSerial2TraceRxDma,          /**< Starting, completing and polling rx DMA transfers */
+    BufferedSerial2TraceSettings,       /**< sigio(), set_rx_notify() and reset_latency() */
+    BufferedSerial2TraceLatency,        /**< Starting a latency sample */
+    BufferedSerial2TraceTxPrime,        /**< Restarting an idle transmitter */
+    BufferedSerial2TraceSites
+};
+
+/** Time bytes spent queued in one BufferedSerial2 buffer, in ticks of
+ *  ticks_hz, see BufferedSerial2::get_rx_latency(). All 0 without
+ *  BUFFEREDSERIAL2_LATENCY
+ */
+struct BufferedSerial2Latency {
+    uint32_t samples;           /**< Bytes measured */
+    uint32_t p50;               /**< Median */
+    uint32_t p99;               /**< 99th percentile */
+    uint32_t p999;              /**< 99.9th percentile */
+    uint32_t max;               /**< Longest */
+    uint32_t ticks_hz;          /**< Rate of the timestamp source, mbed::CycleCounter::hz() */
+};
+
 /**
- *  @class BufferedSerial
+ *  @class BufferedSerial2Port
  *  @brief Software buffers and interrupt driven tx and rx for Serial
+ *
+ *  @tparam RxBufferIndex Index policy of the rx ring, e.g. mbed::CircularBuffer2FixedSize
+ *  @tparam TxBufferIndex Index policy of the tx ring
+ *  @note Use BufferedSerial2, whose index policies BUFFEREDSERIAL2_FIXED_SIZE and
+ *        BUFFEREDSERIAL2_POWER_OF_TWO select, or BufferedSerial2Static, whose
+ *        template parameters size the rings at compile time
  */
-class BufferedSerial2 : public mbed::RawSerial, public mbed::Stream, private mbed::NonCopyable<BufferedSerial2>
+template<typename RxBufferIndex, typename TxBufferIndex>
+class BufferedSerial2Port : public mbed::RawSerial, public mbed::Stream, private mbed::NonCopyable<BufferedSerial2Port<RxBufferIndex, TxBufferIndex> >
 {
 private:
-    mbed::CircularBuffer2<char> _rxbuf;
-    mbed::CircularBuffer2<char> _txbuf;
+#if BUFFEREDSERIAL2_LOCK_FREE && BUFFEREDSERIAL2_CACHE_LINE
+    typedef mbed::CircularBuffer2SPSCCacheAligned<BUFFEREDSERIAL2_CACHE_LINE> RxBufferSync;
+    typedef mbed::CircularBuffer2SPSCCacheAligned<BUFFEREDSERIAL2_CACHE_LINE> TxBufferSync;
+#elif BUFFEREDSERIAL2_LOCK_FREE
+    typedef mbed::CircularBuffer2SPSC RxBufferSync;
+    typedef mbed::CircularBuffer2SPSC TxBufferSync;
+#elif BUFFEREDSERIAL2_LOCK_PRIORITY
+    typedef mbed::CircularBuffer2BasePriority<BUFFEREDSERIAL2_LOCK_PRIORITY> RxBufferSync;
+    typedef mbed::CircularBuffer2BasePriority<BUFFEREDSERIAL2_LOCK_PRIORITY> TxBufferSync;
+#elif BUFFEREDSERIAL2_TRACE_MASKING
+    typedef mbed::CircularBuffer2TracedCriticalSection<BufferedSerial2TraceRxBuffer> RxBufferSync;
+    typedef mbed::CircularBuffer2TracedCriticalSection<BufferedSerial2TraceTxBuffer> TxBufferSync;
+#else
+    typedef mbed::CircularBuffer2CriticalSection RxBufferSync;
+    typedef mbed::CircularBuffer2CriticalSection TxBufferSync;
+#endif
+
+    mbed::CircularBuffer2<char, RxBufferSync, RxBufferIndex, BUFFEREDSERIAL2_COUNTER_TYPE> _rxbuf;
+    mbed::CircularBuffer2<char, TxBufferSync, TxBufferIndex, BUFFEREDSERIAL2_COUNTER_TYPE> _txbuf;
     bool m_block_on_full;
+    bool m_block_on_read;
+    std::size_t m_rx_vmin;
+    uint32_t m_rx_vtime;
+    volatile bool _rx_waiting;
+    std::size_t m_rx_threshold;
+    int m_rx_delimiter;
+    uint32_t m_rx_coalesce_us;
+    mbed::Callback<void()> _sigio;
+    mbed::Timeout _rx_coalesce;
+    volatile bool _rx_coalescing;
+    volatile bool _rx_signalled;
+#if BUFFEREDSERIAL2_STATS
+    BufferedSerial2Stats _stats;        // only ever incremented
+    BufferedSerial2Stats _stats_base;   // _stats at the last reset_stats()
+#endif
+#if BUFFEREDSERIAL2_LATENCY
+    // one byte per direction is timed at a time, from being queued until being taken out
+    struct LatencyProbe {
+        volatile bool active;
+        volatile uint32_t start;
+        volatile size_t ahead;          // bytes still to take out, including the timed one
+        mbed::LatencyHistogram<BUFFEREDSERIAL2_LATENCY_PRECISION> histogram;
+    };
+    LatencyProbe _rx_latency;
+    LatencyProbe _tx_latency;
+#endif
+    uint32_t m_tx_timeout;
+    size_t m_tx_high;
+    size_t m_tx_low;
+    volatile uint32_t _tx_waiting;     // writers sleeping in txWait(), several threads may write
+
+    enum {
+        TxSpaceFlag = (1 << 0),
+        TxEmptyFlag = (1 << 1),
+        RxDataFlag = (1 << 2)
+    };
+
+#if MBED_CONF_RTOS_PRESENT
+    rtos::EventFlags _events;
+#else
+    volatile uint32_t _events;
+#endif
  
     void rxIrq(void);
+    void txStart(void);
+    void rxNotify(bool delimited);
+    void rxCoalesced(void);
+
+    void setEvents(uint32_t flags);
+    void clearEvents(uint32_t flags);
+    bool waitEvents(uint32_t flags, uint32_t timeout_ms);
+    bool txWait(bool drain);
+    void txNotify(void);
+#if BUFFEREDSERIAL2_LATENCY
+    template<typename Buffer>
+    static void latencyIn(LatencyProbe &probe, const Buffer &buf);
+    static void latencyOut(LatencyProbe &probe, size_t length);
+    static BufferedSerial2Latency latencyReport(const LatencyProbe &probe);
+#endif
+
+#if !BUFFEREDSERIAL2_TX_DMA
+    enum {
+        TxIdle,         // tx interrupt off, prime() restarts it
+        TxActive        // tx interrupt on, txIrq() picks up new data by itself
+    };
+    volatile uint8_t _tx_state;
+
     void txIrq(void);
-    void prime(void);
+
+    void txIrqEnable(bool enable)
+    {
+        serial_irq_set(&_serial, (SerialIrq)RawSerial::TxIrq, enable ? 1 : 0);
+    }
+#endif
+
+#if BUFFEREDSERIAL2_TX_DMA
+    volatile size_t _tx_dma_length;    // size of the transfer in flight, 0 when idle
+    mbed::Timeout _tx_dma_retry;
+
+    void txDmaStart(void);
+    void txDmaDone(int event);
+#endif
+
+#if BUFFEREDSERIAL2_RX_DMA
+    volatile size_t _rx_dma_length;    // size of the transfer in flight, 0 when idle
+    size_t _rx_dma_committed;          // part of the transfer already published to _rxbuf
+#if BUFFEREDSERIAL2_RX_DMA_POLL_US
+    size_t _rx_dma_polled;             // rx_buff.pos at the last poll
+    volatile bool _rx_dma_burst;       // a frame is coming in, transfers take all free space
+    mbed::Timeout _rx_dma_poll;
+
+    void rxDmaPoll(void);
+#endif
+
+    void rxDmaStart(void);
+    void rxDmaDone(int event);
+    bool rxDmaSync(void);
+#endif
+
+    /** Check from the writing side if the tx buffer holds more than level bytes,
+     *  while the cached tail index answers that the tx interrupt's one isn't loaded
+     */
+    bool txAbove(size_t level) const
+    {
+        size_t room = _txbuf.capacity() - level;
+        return _txbuf.space(room) < room;
+    }
+
+    /** Make sure tx runs, a single load while the tx interrupt is already on
+     */
+    void prime(void)
+    {
+#if !BUFFEREDSERIAL2_TX_DMA
+        if (core_util_atomic_load_u8(&_tx_state) == TxActive) {
+            return;
+        }
+#endif
+        BufferedSerial2Port::txStart();
+    }
+
+    /** Publish what the rx DMA has received so far, no-op in irq driven mode
+     */
+    void rxFetch(void) const
+    {
+#if BUFFEREDSERIAL2_RX_DMA
+        const_cast<BufferedSerial2Port *>(this)->rxDmaSync();
+#endif
+    }
+
+    /** Re-arm sigio after a read and restart an rx DMA transfer stalled on a full buffer
+     *  @param length Number of bytes the read took out
+     */
+    void rxRelease(size_t length)
+    {
+#if BUFFEREDSERIAL2_LATENCY
+        latencyOut(_rx_latency, length);
+#endif
+        _rx_signalled = false;
+#if BUFFEREDSERIAL2_RX_DMA
+        rxDmaStart();
+#endif
+    }
     
 public:
     /** Create a BufferedSerial port, connected to the specified transmit and receive pins
@@ -105,11 +427,11 @@ public:
      *  @param name optional name
      *  @note Either tx or rx may be specified as NC if unused
      */
-    BufferedSerial2(PinName tx, PinName rx, char *rx_buf, size_t rx_buf_size, char *tx_buf, size_t tx_buf_size, int baud = MBED_CONF_PLATFORM_DEFAULT_SERIAL_BAUD_RATE, bool block_on_full=true);
+    BufferedSerial2Port(PinName tx, PinName rx, char *rx_buf, size_t rx_buf_size, char *tx_buf, size_t tx_buf_size, int baud = MBED_CONF_PLATFORM_DEFAULT_SERIAL_BAUD_RATE, bool block_on_full=true);
     
     /** Destroy a BufferedSerial port
      */
-    virtual ~BufferedSerial2(void);
+    virtual ~BufferedSerial2Port(void);
     
     /** Check on how many bytes are in the rx buffer
      *  @return 1 if something exists, 0 otherwise
@@ -122,8 +444,8 @@ public:
     virtual int writeable(void);
     
     /** Get a single byte from the BufferedSerial Port.
-     *  Should check readable() before calling this.
-     *  @return A byte that came in on the Serial Port
+     *  Should check readable() before calling this, unless in blocking mode.
+     *  @return A byte that came in on the Serial Port, EOF if a blocking read timed out
      */
     virtual int getc(void);
     
@@ -133,18 +455,67 @@ public:
      */
     virtual int putc(int c);
     
+    /** Write a single byte like putc(), but inline and without a virtual call.
+     *  Only a full tx buffer (or latency sampling) goes out of line to putc()
+     *  @param c The byte to write to the Serial Port
+     *  @return The byte that was written, EOF if it wasn't
+     */
+    int put(int c)
+    {
+#if !BUFFEREDSERIAL2_LATENCY
+        // below the high watermark nothing waits and the buffer has room
+        if (!txAbove(m_tx_high - 1)) {
+            bool accepted = _txbuf.push((char)c);
+            BufferedSerial2Port::prime();
+            return accepted ? c : EOF;
+        }
+#endif
+        return BufferedSerial2Port::putc(c);
+    }
+
+    /** Read a single byte like getc(), but inline and without a virtual call.
+     *  Only an empty rx buffer goes out of line to getc()
+     *  @return A byte that came in on the Serial Port, see getc() when there is none
+     */
+    int get()
+    {
+        char c = 0;
+        rxFetch();
+        if (_rxbuf.pop(c)) {
+            rxRelease(1);
+            return (unsigned char)c;
+        }
+        return BufferedSerial2Port::getc();
+    }
+
     /** Write a string to the BufferedSerial Port. Must be NULL terminated
      *  @param s The string to write to the Serial Port
-     *  @return The number of bytes written to the Serial Port Buffer
+     *  @return The number of bytes written to the Serial Port Buffer, including
+     *          the newline, fewer if the tx buffer stayed full, -EAGAIN if nothing was written
      */
     virtual int puts(const char *s);
     
+#if BUFFEREDSERIAL2_FAST_PRINTF
+    /** Write a formatted string to the BufferedSerial Port, formatted in place
+     *  in the tx buffer without stdio or allocations. Supports the flags,
+     *  width, precision and length modifiers of the c, s, d, i, u, o, x, X, p,
+     *  f, F and % conversions. f rounds ties away from 0, is exact to 9
+     *  fraction digits and up to 2^64, larger values print as ovf. Formats
+     *  with anything else, such as e, g, a or n conversions, wide characters
+     *  or the ' flag, go through stdio instead, see Stream::printf()
+     *  @param format The string + format specifiers to write to the Serial Port
+     *  @return The number of bytes written to the Serial Port Buffer
+     */
+    int printf(const char *format, ...) MBED_PRINTF_METHOD(1, 2);
+    int vprintf(const char *format, va_list args) MBED_PRINTF_METHOD(1, 0);
+#else
     /** Write a formatted string to the BufferedSerial Port.
      *  @param format The string + format specifiers to write to the Serial Port
      *  @return The number of bytes written to the Serial Port Buffer
      */
     using Stream::printf;
     using Stream::vprintf;
+#endif
     
     /** Write data to the Buffered Serial Port
      *  @param s A pointer to data to send
@@ -153,18 +524,287 @@ public:
      */
     virtual ssize_t write(const void *s, std::size_t length);
 
-    virtual int sync() {while(!_txbuf.empty()); return 0;}
+    /** Reserve space in the tx buffer so that data can be serialized in place
+     *  @param length The amount of space wanted
+     *  @param first Set to the start of the first writable region
+     *  @param first_length Set to the size of the first region
+     *  @param second Set to the start of the second region if the space wraps, NULL otherwise
+     *  @param second_length Set to the size of the second region
+     *  @return The amount of space reserved, at most length
+     *  @note Only one thread may hold a reservation and it must not write
+     *        through any other call until commit()
+     */
+    size_t reserve(std::size_t length, char *&first, std::size_t &first_length, char *&second, std::size_t &second_length);
 
-    virtual int _putc(int c) {return putc(c);}
-    virtual int _getc() {
-        char c = 0;
-        _rxbuf.pop(c);
-        return c;
+    /** Send data written in place after reserve()
+     *  @param length The amount of data written, at most the amount reserved
+     */
+    void commit(std::size_t length);
+
+    /** Get the received data that can be read in place without popping it
+     *  @param length Set to the amount of data readable at the returned address
+     *  @return Start of the data, valid until consume()
+     *  @note The rx buffer wraps, call again after consume() for the rest
+     */
+    const char *peek_contiguous(std::size_t &length) const;
+
+    /** Drop received data after reading it in place
+     *  @param length The amount of data to drop
+     */
+    void consume(std::size_t length);
+
+    /** Read data from the Buffered Serial Port
+     *  In non-blocking mode returns what is already buffered, in blocking
+     *  mode sleeps until the conditions set by set_read_timing() are met
+     *  @param buffer The buffer to read into
+     *  @param length The amount of data to read
+     *  @return The number of bytes read, -EAGAIN if nothing was read
+     */
+    virtual ssize_t read(void *buffer, std::size_t length);
+
+    /** Set when a blocking read() or getc() returns, in the manner of termios
+     *  VMIN/VTIME. A read returns once vmin bytes (or the whole request, if
+     *  smaller) have arrived. With vtime_ms set it also returns when no byte
+     *  arrives for vtime_ms after the first one, or, if vmin is 0, when
+     *  nothing arrives within vtime_ms of the call
+     *  @param vmin Minimum number of bytes to wait for, SIZE_MAX for the whole request (default)
+     *  @param vtime_ms Inter-byte timeout in milliseconds, 0 to wait indefinitely (default)
+     */
+    void set_read_timing(std::size_t vmin, uint32_t vtime_ms) {m_rx_vmin = vmin; m_rx_vtime = vtime_ms;}
+
+    /** Set blocking or non-blocking mode for read(). Writes keep following
+     *  the block_on_full constructor argument
+     *  @param blocking true for blocking mode, false for non-blocking mode
+     *  @return 0 on success
+     */
+    virtual int set_blocking(bool blocking) {m_block_on_read = blocking; return 0;}
+
+    /** Check current read blocking or non-blocking mode
+     *  @return true for blocking mode, false for non-blocking mode
+     */
+    virtual bool is_blocking() const {return m_block_on_read;}
+
+    /** Set how long putc(), puts(), write() and sync() wait for the transmitter
+     *  to make progress when the tx buffer is full (or, for sync(), not empty).
+     *  Threads sleep while waiting, interrupt handlers spin
+     *  @param timeout_ms The timeout in milliseconds, or BUFFEREDSERIAL2_WAIT_FOREVER
+     */
+    void set_tx_timeout(uint32_t timeout_ms) {m_tx_timeout = timeout_ms;}
+
+    /** Set the tx buffer levels at which blocking writers stop and resume.
+     *  A writer that fills the buffer up to high sleeps until it drains to low,
+     *  so writers are woken in batches instead of for every byte sent
+     *  @param high Level at which writers block, at most the tx buffer size
+     *  @param low Level at which writers are woken, lower than high
+     */
+    void set_tx_watermarks(std::size_t high, std::size_t low);
+
+    /** Wait until everything in the tx buffer has been handed to the hardware
+     *  @return 0 on success, -ETIMEDOUT if the tx timeout expired
+     */
+    virtual int sync();
+
+    virtual int _putc(int c) {return BufferedSerial2Port::put(c);}
+    virtual int _getc() {return BufferedSerial2Port::get();}
+
+    /** Register a callback for incoming data, see set_rx_notify() for when it
+     *  is called. Notifications are edge triggered: after one, the next comes
+     *  only once the application has read, so it should read until -EAGAIN
+     *  @param func Function to call from interrupt context, or NULL to stop notifications
+     */
+    virtual void sigio(mbed::Callback<void()> func);
+
+    /** Set what happens to received data when the rx buffer is full
+     *  @param policy mbed::CircularBuffer2OverwriteOldest (default, not available lock-free),
+     *         mbed::CircularBuffer2DropNewest (default lock-free) or mbed::CircularBuffer2Reject
+     */
+    void set_rx_overflow(mbed::CircularBuffer2Overflow policy) {_rxbuf.set_overflow(policy);}
+
+    /** Set what happens to written data when the tx buffer is full and writes don't block.
+     *  With mbed::CircularBuffer2Reject, write() returns the count that fit and putc() returns EOF
+     *  @param policy mbed::CircularBuffer2OverwriteOldest (default, not available lock-free or with
+     *         BUFFEREDSERIAL2_TX_DMA), mbed::CircularBuffer2DropNewest (default lock-free or with
+     *         BUFFEREDSERIAL2_TX_DMA) or mbed::CircularBuffer2Reject
+     */
+    void set_tx_overflow(mbed::CircularBuffer2Overflow policy)
+    {
+        // the DMA reads the bytes in flight from the buffer, they must not be overwritten
+        MBED_ASSERT(!BUFFEREDSERIAL2_TX_DMA || policy != mbed::CircularBuffer2OverwriteOldest);
+        _txbuf.set_overflow(policy);
     }
 
+    /** Get the number of received bytes lost because the rx buffer was full
+     */
+    uint32_t rx_dropped() const {return _rxbuf.dropped();}
+
+    /** Get the number of written bytes lost because the tx buffer was full
+     */
+    uint32_t tx_dropped() const {return _txbuf.dropped();}
+
+    /** Reset the rx and tx lost byte counts
+     */
+    void reset_dropped() {_rxbuf.reset_dropped(); _txbuf.reset_dropped();}
+
+    /** Get the statistics gathered since construction or the last reset_stats().
+     *  Doesn't lock: each counter is updated and read atomically, but interrupts
+     *  may update some counters while others are read
+     *  @return The statistics
+     */
+    BufferedSerial2Stats get_stats() const;
+
+    /** Restart the statistics, including the dropped counts
+     */
+    void reset_stats();
+
+    /** Get the sizing report of the rx buffer.
+     *  With CIRCULARBUFFER2_HISTOGRAM the recommendation is the smallest power
+     *  of two that would have held all but target_loss_ppm of the received
+     *  bytes. Without it, it is the high water mark, which loses nothing, if
+     *  CIRCULARBUFFER2_HIGH_WATER is set and 0 otherwise. If the buffer
+     *  already lost more than the target, it is the next power of two above
+     *  the current size and should be measured again
+     *  @param target_loss_ppm Acceptable loss, in bytes per million
+     *  @return The report
+     */
+    BufferedSerial2Sizing get_rx_sizing(uint32_t target_loss_ppm = 0) const;
+
+    /** Get the sizing report of the tx buffer, see get_rx_sizing().
+     *  Blocking writers fill the buffer before they wait, so this is only
+     *  meaningful for non blocking writes
+     */
+    BufferedSerial2Sizing get_tx_sizing(uint32_t target_loss_ppm = 0) const;
+
+    /** Restart the rx and tx sizing reports, including the dropped counts
+     */
+    void reset_sizing();
+
+    /** Get how long received bytes waited in the rx buffer until read.
+     *  Bytes are sampled one at a time, the next one is timed once the
+     *  previous one was read. Samples are too long when bytes were dropped
+     *  @return The percentiles, all 0 without BUFFEREDSERIAL2_LATENCY
+     */
+    BufferedSerial2Latency get_rx_latency() const;
+
+    /** Get how long written bytes waited in the tx buffer until sent to the
+     *  hardware, see get_rx_latency()
+     */
+    BufferedSerial2Latency get_tx_latency() const;
+
+    /** Restart the rx and tx latency measurements
+     */
+    void reset_latency();
+
+    /** Set when sigio is called for incoming data
+     *  @param threshold Notify once the rx buffer holds this many bytes (default 1)
+     *  @param delimiter Notify when this byte arrives, -1 for none (default)
+     *  @param coalesce_us Otherwise notify this long after the first byte, 0 to disable (default)
+     */
+    void set_rx_notify(std::size_t threshold, int delimiter = -1, uint32_t coalesce_us = 0);
+
+#if BUFFEREDSERIAL2_RX_DMA
+    /** Publish what the rx DMA has received so far and wake readers and sigio.
+     *  Call it from the UART's idle-line interrupt where the target has one
+     */
+    void rx_idle(void);
+
+#endif
     virtual short poll(short events) const {
-        return _rxbuf.empty() ? 0 : POLLIN;
+        rxFetch();
+        return _rxbuf.available(1) ? POLLIN : 0;
     }
 };
 
+#include "BufferedSerial2Impl.h"
+
+// Index policies of BufferedSerial2, whose buffer sizes are only known at run time
+#if BUFFEREDSERIAL2_FIXED_SIZE
+typedef mbed::CircularBuffer2FixedSize<BUFFEREDSERIAL2_RX_SIZE> BufferedSerial2RxIndex;
+typedef mbed::CircularBuffer2FixedSize<BUFFEREDSERIAL2_TX_SIZE> BufferedSerial2TxIndex;
+#elif BUFFEREDSERIAL2_POWER_OF_TWO
+typedef mbed::CircularBuffer2PowerOfTwo BufferedSerial2RxIndex;
+typedef mbed::CircularBuffer2PowerOfTwo BufferedSerial2TxIndex;
+#else
+typedef mbed::CircularBuffer2AnySize BufferedSerial2RxIndex;
+typedef mbed::CircularBuffer2AnySize BufferedSerial2TxIndex;
+#endif
+
+// instantiated once, in BufferedSerial2.cpp
+extern template class BufferedSerial2Port<BufferedSerial2RxIndex, BufferedSerial2TxIndex>;
+
+/**
+ *  @class BufferedSerial2
+ *  @brief BufferedSerial2Port on buffers given at run time
+ */
+class BufferedSerial2 : public BufferedSerial2Port<BufferedSerial2RxIndex, BufferedSerial2TxIndex>
+{
+public:
+    /** Create a BufferedSerial port, connected to the specified transmit and receive pins
+     *  @param tx Transmit pin
+     *  @param rx Receive pin
+     *  @param rx_buf Rx buffer
+     *  @param rx_buf_size Rx buffer size
+     *  @param tx_buf Tx buffer
+     *  @param tx_buf_size Tx buffer size
+     *  @param baud The baud rate
+     *  @param block_on_full Block writers while the tx buffer is full instead of overwriting it
+     *  @note Either tx or rx may be specified as NC if unused
+     */
+    BufferedSerial2(PinName tx, PinName rx, char *rx_buf, size_t rx_buf_size, char *tx_buf, size_t tx_buf_size, int baud = MBED_CONF_PLATFORM_DEFAULT_SERIAL_BAUD_RATE, bool block_on_full=true)
+        : BufferedSerial2Port<BufferedSerial2RxIndex, BufferedSerial2TxIndex>(tx, rx, rx_buf, rx_buf_size, tx_buf, tx_buf_size, baud, block_on_full)
+    {
+    }
+};
+
+/** Storage for BufferedSerial2Static, a base so that it exists before BufferedSerial2Port uses it
+ */
+template<std::size_t RxN, std::size_t TxN>
+struct BufferedSerial2Storage {
+    char rx_storage[RxN];
+    char tx_storage[TxN];
+};
+
+/**
+ *  @class BufferedSerial2Static
+ *  @brief BufferedSerial2Port that owns its buffers, sized at compile time
+ *
+ *  The rings use mbed::CircularBuffer2FixedSize, so every index update folds
+ *  the sizes in as constants, with mask arithmetic for powers of two.
+ *
+ *  The buffers are part of the object, so placing the object places them:
+ *  declare it with MBED_SECTION() to put it in fast RAM such as DTCM or CCM.
+ *
+ *  @code
+ *  MBED_SECTION(".dtcm") static BufferedSerial2Static<256, 512> pc(USBTX, USBRX);
+ *  @endcode
+ */
+template<std::size_t RxN = BUFFEREDSERIAL2_RX_SIZE, std::size_t TxN = BUFFEREDSERIAL2_TX_SIZE>
+class BufferedSerial2Static : private BufferedSerial2Storage<RxN, TxN>,
+    public BufferedSerial2Port<mbed::CircularBuffer2FixedSize<RxN>, mbed::CircularBuffer2FixedSize<TxN> >
+{
+    MBED_STRUCT_STATIC_ASSERT(RxN > 0 && TxN > 0, "BufferedSerial2Static: buffer sizes must not be 0");
+    MBED_STRUCT_STATIC_ASSERT(RxN <= ((BUFFEREDSERIAL2_COUNTER_TYPE)(-1) / 2) + 1ull && TxN <= ((BUFFEREDSERIAL2_COUNTER_TYPE)(-1) / 2) + 1ull,
+                              "BufferedSerial2Static: buffer sizes too large for BUFFEREDSERIAL2_COUNTER_TYPE");
+
+public:
+    static const std::size_t rx_capacity = RxN;
+    static const std::size_t tx_capacity = TxN;
+
+    /** Create a BufferedSerial port with its own buffers
+     *  @param tx Transmit pin
+     *  @param rx Receive pin
+     *  @param baud The baud rate
+     *  @param block_on_full Block writers while the tx buffer is full instead of overwriting it
+     */
+    BufferedSerial2Static(PinName tx, PinName rx, int baud = MBED_CONF_PLATFORM_DEFAULT_SERIAL_BAUD_RATE, bool block_on_full = true)
+        : BufferedSerial2Port<mbed::CircularBuffer2FixedSize<RxN>, mbed::CircularBuffer2FixedSize<TxN> >(tx, rx, this->rx_storage, RxN, this->tx_storage, TxN, baud, block_on_full)
+    {
+    }
+};
+
+template<std::size_t RxN, std::size_t TxN>
+const std::size_t BufferedSerial2Static<RxN, TxN>::rx_capacity;
+
+template<std::size_t RxN, std::size_t TxN>
+const std::size_t BufferedSerial2Static<RxN, TxN>::tx_capacity;
+
 #endif
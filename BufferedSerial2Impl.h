@@ -0,0 +1,1431 @@
+/**
+ * @file    BufferedSerial2Impl.h
+ * @brief   Software Buffer - Extends mbed Serial functionallity adding irq driven TX and RX
+ * @author  sam grove
+ * @version 1.0
+ * @see
+ *
+ * Copyright (c) 2013
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Member definitions of BufferedSerial2Port, included by BufferedSerial2.h so
+// that BufferedSerial2Static can instantiate them for its buffer sizes
+
+#ifndef BUFFEREDSERIAL2IMPL_H
+#define BUFFEREDSERIAL2IMPL_H
+
+#include "Serial.h"
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include "hal/us_ticker_api.h"
+
+#if BUFFEREDSERIAL2_STATS
+// threads and interrupts add to the same counters, e.g. prime() and txIrq() to tx_bytes
+#define BUFFEREDSERIAL2_STAT_ADD(field, n) core_util_atomic_incr_u32(&_stats.field, (n))
+#else
+#define BUFFEREDSERIAL2_STAT_ADD(field, n)
+#endif
+
+#if BUFFEREDSERIAL2_TRACE_MASKING
+#define BUFFEREDSERIAL2_CRITICAL_ENTER(site) mbed::CriticalSectionTrace::enter(BufferedSerial2Trace##site)
+#define BUFFEREDSERIAL2_CRITICAL_EXIT() mbed::CriticalSectionTrace::exit()
+MBED_STATIC_ASSERT(BufferedSerial2TraceSites <= CRITICALSECTIONTRACE_SITES, "CRITICALSECTIONTRACE_SITES too small for BufferedSerial2");
+#else
+#define BUFFEREDSERIAL2_CRITICAL_ENTER(site) core_util_critical_section_enter()
+#define BUFFEREDSERIAL2_CRITICAL_EXIT() core_util_critical_section_exit()
+#endif
+
+// restarting tx only races with the tx interrupt, so it can use the rings' priority mask
+#if BUFFEREDSERIAL2_LOCK_PRIORITY
+#define BUFFEREDSERIAL2_PRIME_ENTER() mbed::CircularBuffer2BasePriority<BUFFEREDSERIAL2_LOCK_PRIORITY>::lock()
+#define BUFFEREDSERIAL2_PRIME_EXIT() mbed::CircularBuffer2BasePriority<BUFFEREDSERIAL2_LOCK_PRIORITY>::unlock()
+#else
+#define BUFFEREDSERIAL2_PRIME_ENTER() BUFFEREDSERIAL2_CRITICAL_ENTER(TxPrime)
+#define BUFFEREDSERIAL2_PRIME_EXIT() BUFFEREDSERIAL2_CRITICAL_EXIT()
+#endif
+
+#if BUFFEREDSERIAL2_LATENCY
+#define BUFFEREDSERIAL2_LATENCY_IN(probe, buf) BufferedSerial2Port::latencyIn(probe, buf)
+#define BUFFEREDSERIAL2_LATENCY_OUT(probe, length) BufferedSerial2Port::latencyOut(probe, length)
+#else
+#define BUFFEREDSERIAL2_LATENCY_IN(probe, buf)
+#define BUFFEREDSERIAL2_LATENCY_OUT(probe, length)
+#endif
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::BufferedSerial2Port(PinName tx, PinName rx, char *rx_buf, size_t rx_buf_size, char *tx_buf, size_t tx_buf_size, int baud, bool block_on_full)
+    : _rxbuf(rx_buf, rx_buf_size), _txbuf(tx_buf, tx_buf_size), RawSerial(tx, rx, baud), m_block_on_full(block_on_full), m_block_on_read(false),
+      m_rx_vmin(SIZE_MAX), m_rx_vtime(0), _rx_waiting(false),
+      m_rx_threshold(1), m_rx_delimiter(-1), m_rx_coalesce_us(0), _rx_coalescing(false), _rx_signalled(false),
+      m_tx_timeout(BUFFEREDSERIAL2_WAIT_FOREVER), m_tx_high(tx_buf_size), m_tx_low(tx_buf_size / 2), _tx_waiting(0)
+{
+#if !MBED_CONF_RTOS_PRESENT
+    _events = 0;
+#endif
+#if BUFFEREDSERIAL2_STATS
+    memset(&_stats, 0, sizeof(_stats));
+    memset(&_stats_base, 0, sizeof(_stats_base));
+#endif
+#if BUFFEREDSERIAL2_LATENCY || BUFFEREDSERIAL2_TRACE_MASKING
+    mbed::CycleCounter::start();
+#endif
+#if BUFFEREDSERIAL2_LATENCY
+    _rx_latency.active = false;
+    _tx_latency.active = false;
+#endif
+#if BUFFEREDSERIAL2_TX_DMA
+    _tx_dma_length = 0;
+    _txbuf.set_overflow(mbed::CircularBuffer2DropNewest);
+    SerialBase::set_dma_usage_tx(DMA_USAGE_ALWAYS);
+#else
+    // attach once, from here on only the interrupt source is switched
+    _tx_state = TxIdle;
+    RawSerial::attach(mbed::callback(this, &BufferedSerial2Port::txIrq), RawSerial::TxIrq);
+    BufferedSerial2Port::txIrqEnable(false);
+#endif
+#if BUFFEREDSERIAL2_RX_DMA
+    _rx_dma_length = 0;
+    _rx_dma_committed = 0;
+#if BUFFEREDSERIAL2_RX_DMA_POLL_US
+    _rx_dma_polled = 0;
+    _rx_dma_burst = false;
+#endif
+    SerialBase::set_dma_usage_rx(DMA_USAGE_ALWAYS);
+    BufferedSerial2Port::rxDmaStart();
+#else
+    RawSerial::attach(mbed::callback(this, &BufferedSerial2Port::rxIrq), RawSerial::RxIrq);
+#endif
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::~BufferedSerial2Port(void)
+{
+    RawSerial::attach(NULL, RawSerial::RxIrq);
+    RawSerial::attach(NULL, RawSerial::TxIrq);
+#if BUFFEREDSERIAL2_TX_DMA
+    _tx_dma_retry.detach();
+    SerialBase::abort_write();
+#endif
+#if BUFFEREDSERIAL2_RX_DMA
+#if BUFFEREDSERIAL2_RX_DMA_POLL_US
+    _rx_dma_poll.detach();
+#endif
+    SerialBase::abort_read();
+#endif
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+bool BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::readable() const
+{
+    rxFetch();
+    return _rxbuf.available(1) ? true : false;  // note: look if things are in the buffer
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+int BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::writeable(void)
+{
+    return 1;   // buffer allows overwriting by design, always true
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+int BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::getc(void)
+{
+    char c = 0;
+    if (m_block_on_read) {
+        return (BufferedSerial2Port::read(&c, 1) == 1) ? (unsigned char)c : EOF;
+    }
+    rxFetch();
+    bool popped = _rxbuf.pop(c);
+    rxRelease(popped ? 1 : 0);
+    return (unsigned char)c;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+int BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::putc(int c)
+{
+    if (m_block_on_full && !BufferedSerial2Port::txWait(false)) {
+        return EOF;
+    }
+    bool accepted = _txbuf.push((char)c);
+    if (accepted) {
+        BUFFEREDSERIAL2_LATENCY_IN(_tx_latency, _txbuf);
+    }
+    BufferedSerial2Port::prime();
+
+    return accepted ? c : EOF;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+int BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::puts(const char *s)
+{
+    if (s != NULL) {
+        ssize_t length = strlen(s);
+        ssize_t written = length ? BufferedSerial2Port::write(s, length) : 0;
+
+        // a short count, or the error when nothing fit
+        if (written < length) {
+            return written;
+        }
+        if (BufferedSerial2Port::write("\n", 1) != 1) {  // done per puts definition
+            return length ? length : -EAGAIN;
+        }
+
+        return length + 1;
+    }
+    return 0;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+ssize_t BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::write(const void *s, size_t length)
+{
+    if (s != NULL && length > 0) {
+        const char* ptr = (const char*)s;
+        const char* end = ptr + length;
+
+        while (ptr != end) {
+            if (m_block_on_full) {
+                // fill up to the high watermark, then sleep until tx drains to the low one
+                // exact from the high watermark up, below it the stale cached tail may overstate it
+                size_t level = _txbuf.capacity() - _txbuf.space(_txbuf.capacity() - m_tx_high + 1);
+                if (level >= m_tx_high) {
+                    if (!BufferedSerial2Port::txWait(false)) {
+                        break;
+                    }
+                    continue;
+                }
+                size_t length = end - ptr;
+                ptr += _txbuf.push(ptr, length < m_tx_high - level ? length : m_tx_high - level);
+            } else {
+                size_t pushed = _txbuf.push(ptr, end - ptr);
+                ptr += pushed;
+                // full: the tx buffer's overflow policy decides what happens to the rest
+                if (pushed == 0) {
+                    if (!_txbuf.push(*ptr)) {
+                        break;
+                    }
+                    ptr++;
+                }
+            }
+        }
+        if (ptr != (const char*)s) {
+            BUFFEREDSERIAL2_LATENCY_IN(_tx_latency, _txbuf);
+        }
+        BufferedSerial2Port::prime();
+
+        if (ptr == (const char*)s) {
+            return -EAGAIN;
+        }
+        return ptr - (const char*)s;
+    }
+    return 0;
+}
+
+#if BUFFEREDSERIAL2_FAST_PRINTF
+namespace BufferedSerial2Impl {
+
+// Writes formatted output into reserved tx space, and through putc() once the reservation is used up
+template<typename Port>
+class TxFormatSink {
+public:
+    TxFormatSink(Port &port) : _port(port), _first(NULL), _first_length(0), _second(NULL), _second_length(0), _used(0), _count(0)
+    {
+        _port.reserve(SIZE_MAX, _first, _first_length, _second, _second_length);
+    }
+
+    void put(const char *s, size_t length)
+    {
+        _count += length;
+        while (length > 0) {
+            if (_used == _first_length + _second_length && !refill()) {
+                _port.putc(*s++);
+                length--;
+                continue;
+            }
+            char *dst = _used < _first_length ? &_first[_used] : &_second[_used - _first_length];
+            size_t room = _used < _first_length ? _first_length - _used : _first_length + _second_length - _used;
+            size_t n = length < room ? length : room;
+            memcpy(dst, s, n);
+            _used += n;
+            s += n;
+            length -= n;
+        }
+    }
+
+    void pad(char c, size_t length)
+    {
+        char fill[8];
+        memset(fill, c, sizeof(fill));
+        while (length > 0) {
+            size_t n = length < sizeof(fill) ? length : sizeof(fill);
+            put(fill, n);
+            length -= n;
+        }
+    }
+
+    int finish()
+    {
+        _port.commit(_used);
+        return _count;
+    }
+
+private:
+    // hand over what was written and reserve whatever is free now
+    bool refill()
+    {
+        _port.commit(_used);
+        _used = 0;
+        return _port.reserve(SIZE_MAX, _first, _first_length, _second, _second_length) != 0;
+    }
+
+    Port &_port;
+    char *_first;
+    size_t _first_length;
+    char *_second;
+    size_t _second_length;
+    size_t _used;
+    int _count;
+};
+
+struct FormatSpec {
+    bool left;
+    bool plus;
+    bool space;
+    bool alt;
+    bool zero;
+    size_t width;
+    int precision;      // -1 when not given
+};
+
+// write v in decimal backwards from end, two digits per division, 64 bit divisions only above 2^32
+inline char *format_decimal(uint64_t v, char *end)
+{
+    static const char format_digit_pairs[] =
+        "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839" "40414243444546474849"
+        "50515253545556575859" "60616263646566676869" "70717273747576777879" "80818283848586878889" "90919293949596979899";
+
+    while (v > 0xFFFFFFFFu) {
+        uint32_t low = (uint32_t)(v % 1000000000u);
+        v /= 1000000000u;
+        for (int i = 0; i < 9; i++) {
+            *--end = '0' + low % 10;
+            low /= 10;
+        }
+    }
+    uint32_t n = (uint32_t)v;
+    while (n >= 100) {
+        const char *pair = &format_digit_pairs[(n % 100) * 2];
+        n /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    if (n >= 10) {
+        *--end = format_digit_pairs[n * 2 + 1];
+        *--end = format_digit_pairs[n * 2];
+    } else {
+        *--end = '0' + n;
+    }
+    return end;
+}
+
+inline char *format_base(uint64_t v, char *end, unsigned shift, const char *digits)
+{
+    do {
+        *--end = digits[v & ((1u << shift) - 1)];
+        v >>= shift;
+    } while (v != 0);
+    return end;
+}
+
+// prefix (sign, 0x), zeros up to min_digits, digits, trailing zeros, all padded to the width
+template<typename Sink>
+void format_emit(Sink &sink, const FormatSpec &spec, const char *prefix, const char *digits, size_t length,
+                 size_t min_digits, size_t trailing)
+{
+    size_t prefix_length = strlen(prefix);
+    size_t leading = min_digits > length ? min_digits - length : 0;
+    size_t total = prefix_length + leading + length + trailing;
+    size_t fill = spec.width > total ? spec.width - total : 0;
+
+    if (!spec.left && !spec.zero) {
+        sink.pad(' ', fill);
+    }
+    sink.put(prefix, prefix_length);
+    if (!spec.left && spec.zero) {
+        sink.pad('0', fill);
+    }
+    sink.pad('0', leading);
+    sink.put(digits, length);
+    sink.pad('0', trailing);
+    if (spec.left) {
+        sink.pad(' ', fill);
+    }
+}
+
+// whether the format has a conversion the fast path can't print like stdio: e, g and a, which
+// need the shortest digits, n, wide characters, flags like ' or anything malformed
+inline bool format_needs_stdio(const char *format)
+{
+    for (const char *p = format; (p = strchr(p, '%')) != NULL; p++) {
+        const char *spec = ++p;
+        p += strspn(p, "-+ #0");
+        p += *p == '*' ? 1 : strspn(p, "0123456789");
+        if (*p == '.') {
+            p++;
+            p += *p == '*' ? 1 : strspn(p, "0123456789");
+        }
+        const char *length = p;
+        if ((*p == 'h' || *p == 'l') && p[1] == *p) {
+            p += 2;
+        } else if (*p != '\0' && strchr("hlzjtL", *p) != NULL) {
+            p++;
+        }
+        char modifier = p != length ? *length : '\0';
+        char c = *p;
+        bool integer = c != '\0' && strchr("diouxX", c) != NULL && modifier != 'L';
+        bool fixed = (c == 'f' || c == 'F') &&
+                     (modifier == '\0' || (p - length == 1 && (modifier == 'l' || modifier == 'L')));
+        bool plain = (c == 'c' || c == 's' || c == 'p') && modifier == '\0';
+        if (!integer && !fixed && !plain && !(c == '%' && p == spec)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline const char *format_sign(bool negative, const FormatSpec &spec)
+{
+    return negative ? "-" : spec.plus ? "+" : spec.space ? " " : "";
+}
+
+// fixed point: integer part and up to 9 rounded fraction digits in integer arithmetic, more digits are zeros
+template<typename Sink>
+void format_fixed(Sink &sink, FormatSpec spec, double x, bool upper)
+{
+    static const uint32_t scales[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+    char buf[32];
+    char *end = buf + sizeof(buf);
+    char *start = end;
+    bool negative = signbit(x) != 0;
+    size_t precision = spec.precision < 0 ? 6 : spec.precision;
+    size_t digits = precision < 9 ? precision : 9;
+
+    if (negative) {
+        x = -x;
+    }
+    if (x != x || x - x != 0 || x >= 18446744073709551615.0) {
+        // nan, inf, or too large for the integer part
+        spec.zero = false;
+        const char *text = x != x ? (upper ? "NAN" : "nan") : x - x != 0 ? (upper ? "INF" : "inf") : (upper ? "OVF" : "ovf");
+        format_emit(sink, spec, format_sign(negative, spec), text, 3, 0, 0);
+        return;
+    }
+    uint64_t integer = (uint64_t)x;
+    double scaled = (x - (double)integer) * scales[digits] + 0.5;
+    uint32_t fraction = (uint32_t)scaled;
+    if (fraction >= scales[digits]) {
+        fraction -= scales[digits];
+        integer++;
+    }
+    if (digits > 0) {
+        for (size_t i = 0; i < digits; i++) {
+            *--start = '0' + fraction % 10;
+            fraction /= 10;
+        }
+    }
+    if (digits > 0 || spec.alt) {
+        *--start = '.';
+    }
+    start = format_decimal(integer, start);
+    format_emit(sink, spec, format_sign(negative, spec), start, end - start, 0, precision - digits);
+}
+
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+int BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int count = BufferedSerial2Port::vprintf(format, args);
+    va_end(args);
+
+    return count;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+int BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::vprintf(const char *format, va_list args)
+{
+    using namespace BufferedSerial2Impl;
+    if (format_needs_stdio(format)) {
+        return Stream::vprintf(format, args);
+    }
+    TxFormatSink<BufferedSerial2Port> sink(*this);
+    const char *p = format;
+
+    while (*p != '\0') {
+        // literal text goes out in runs
+        const char *text = p;
+        while (*p != '\0' && *p != '%') {
+            p++;
+        }
+        sink.put(text, p - text);
+        if (*p == '\0') {
+            break;
+        }
+        p++;
+
+        FormatSpec spec = {false, false, false, false, false, 0, -1};
+        for (;; p++) {
+            if (*p == '-') {
+                spec.left = true;
+            } else if (*p == '+') {
+                spec.plus = true;
+            } else if (*p == ' ') {
+                spec.space = true;
+            } else if (*p == '#') {
+                spec.alt = true;
+            } else if (*p == '0') {
+                spec.zero = true;
+            } else {
+                break;
+            }
+        }
+        if (*p == '*') {
+            int width = va_arg(args, int);
+            spec.left |= width < 0;
+            spec.width = width < 0 ? -width : width;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                spec.width = spec.width * 10 + (*p++ - '0');
+            }
+        }
+        if (*p == '.') {
+            p++;
+            spec.precision = 0;
+            if (*p == '*') {
+                int precision = va_arg(args, int);
+                spec.precision = precision < 0 ? -1 : precision;
+                p++;
+            } else {
+                while (*p >= '0' && *p <= '9') {
+                    spec.precision = spec.precision * 10 + (*p++ - '0');
+                }
+            }
+        }
+
+        enum {LengthInt, LengthChar, LengthShort, LengthLong, LengthLongLong, LengthSize, LengthMax, LengthPtrdiff, LengthLongDouble} length = LengthInt;
+        if (*p == 'h') {
+            length = (*++p == 'h') ? (p++, LengthChar) : LengthShort;
+        } else if (*p == 'l') {
+            length = (*++p == 'l') ? (p++, LengthLongLong) : LengthLong;
+        } else if (*p == 'z') {
+            length = LengthSize;
+            p++;
+        } else if (*p == 'j') {
+            length = LengthMax;
+            p++;
+        } else if (*p == 't') {
+            length = LengthPtrdiff;
+            p++;
+        } else if (*p == 'L') {
+            length = LengthLongDouble;
+            p++;
+        }
+
+        char buf[24];
+        char *end = buf + sizeof(buf);
+        char *start = end;
+        char c = *p;
+        switch (c) {
+            case 'd':
+            case 'i': {
+                int64_t v;
+                switch (length) {
+                    case LengthLong: v = va_arg(args, long); break;
+                    case LengthLongLong: v = va_arg(args, long long); break;
+                    case LengthSize: v = va_arg(args, ssize_t); break;
+                    case LengthMax: v = va_arg(args, intmax_t); break;
+                    case LengthPtrdiff: v = va_arg(args, ptrdiff_t); break;
+                    case LengthChar: v = (signed char)va_arg(args, int); break;
+                    case LengthShort: v = (short)va_arg(args, int); break;
+                    default: v = va_arg(args, int); break;
+                }
+                uint64_t magnitude = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+                if (magnitude != 0 || spec.precision != 0) {
+                    start = format_decimal(magnitude, end);
+                }
+                spec.zero &= spec.precision < 0;
+                format_emit(sink, spec, format_sign(v < 0, spec), start, end - start, spec.precision < 0 ? 0 : spec.precision, 0);
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o': {
+                uint64_t v;
+                switch (length) {
+                    case LengthLong: v = va_arg(args, unsigned long); break;
+                    case LengthLongLong: v = va_arg(args, unsigned long long); break;
+                    case LengthSize: v = va_arg(args, size_t); break;
+                    case LengthMax: v = va_arg(args, uintmax_t); break;
+                    case LengthPtrdiff: v = (uint64_t)va_arg(args, ptrdiff_t); break;
+                    case LengthChar: v = (unsigned char)va_arg(args, unsigned int); break;
+                    case LengthShort: v = (unsigned short)va_arg(args, unsigned int); break;
+                    default: v = va_arg(args, unsigned int); break;
+                }
+                const char *prefix = "";
+                size_t min_digits = spec.precision < 0 ? 0 : spec.precision;
+                if (v != 0 || spec.precision != 0) {
+                    if (c == 'u') {
+                        start = format_decimal(v, end);
+                    } else if (c == 'o') {
+                        start = format_base(v, end, 3, "01234567");
+                    } else {
+                        start = format_base(v, end, 4, c == 'x' ? "0123456789abcdef" : "0123456789ABCDEF");
+                    }
+                }
+                if (spec.alt && c == 'o' && min_digits <= (size_t)(end - start) && (start == end || *start != '0')) {
+                    min_digits = (end - start) + 1;     // the leading 0 of the alternative form
+                } else if (spec.alt && c != 'u' && c != 'o' && v != 0) {
+                    prefix = c == 'x' ? "0x" : "0X";
+                }
+                spec.zero &= spec.precision < 0;
+                format_emit(sink, spec, prefix, start, end - start, min_digits, 0);
+                break;
+            }
+            case 'p': {
+                start = format_base((uintptr_t)va_arg(args, void *), end, 4, "0123456789abcdef");
+                format_emit(sink, spec, "0x", start, end - start, 0, 0);
+                break;
+            }
+            case 'c': {
+                buf[0] = (char)va_arg(args, int);
+                spec.zero = false;
+                format_emit(sink, spec, "", buf, 1, 0, 0);
+                break;
+            }
+            case 's': {
+                const char *s = va_arg(args, const char *);
+                if (s == NULL) {
+                    s = "(null)";
+                }
+                size_t n = 0;
+                while (s[n] != '\0' && (spec.precision < 0 || n < (size_t)spec.precision)) {
+                    n++;
+                }
+                spec.zero = false;
+                format_emit(sink, spec, "", s, n, 0, 0);
+                break;
+            }
+            case 'f':
+            case 'F':
+                if (length == LengthLongDouble) {
+                    format_fixed(sink, spec, (double)va_arg(args, long double), c == 'F');
+                } else {
+                    format_fixed(sink, spec, va_arg(args, double), c == 'F');
+                }
+                break;
+            default:
+                // %%, format_needs_stdio() sent every other conversion to stdio
+                sink.put("%", 1);
+                break;
+        }
+        p++;
+    }
+
+    return sink.finish();
+}
+#endif
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::set_tx_watermarks(size_t high, size_t low)
+{
+    MBED_ASSERT(low < high && high <= _txbuf.capacity());
+    m_tx_high = high;
+    m_tx_low = low;
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+int BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::sync()
+{
+    return BufferedSerial2Port::txWait(true) ? 0 : -ETIMEDOUT;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+size_t BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::reserve(size_t length, char *&first, size_t &first_length, char *&second, size_t &second_length)
+{
+    return _txbuf.reserve(length, first, first_length, second, second_length);
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::commit(size_t length)
+{
+    _txbuf.commit(length);
+    BUFFEREDSERIAL2_LATENCY_IN(_tx_latency, _txbuf);
+    BufferedSerial2Port::prime();
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+const char *BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::peek_contiguous(size_t &length) const
+{
+    rxFetch();
+    return _rxbuf.peek_contiguous(length);
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::consume(size_t length)
+{
+    _rxbuf.consume(length);
+    rxRelease(length);
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+ssize_t BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::read(void *buffer, size_t length)
+{
+    char* ptr = (char*)buffer;
+    char* end = ptr + length;
+    size_t wanted = 0;
+    size_t popped = 0;
+
+    if (length == 0) {
+        return 0;
+    }
+
+    if (m_block_on_read) {
+        // vmin 0 still waits for one byte, but the timer then covers the whole read
+        wanted = m_rx_vmin == 0 ? 1 : (m_rx_vmin < length ? m_rx_vmin : length);
+    }
+
+    rxFetch();
+    popped = _rxbuf.pop(ptr, end - ptr);
+    ptr += popped;
+    rxRelease(popped);
+
+    while ((size_t)(ptr - (char*)buffer) < wanted) {
+        // announce the wait before checking again, so rxIrq can't slip data in unnoticed
+        _rx_waiting = true;
+        BufferedSerial2Port::clearEvents(RxDataFlag);
+        rxFetch();
+        popped = _rxbuf.pop(ptr, end - ptr);
+        ptr += popped;
+        rxRelease(popped);
+        if ((size_t)(ptr - (char*)buffer) >= wanted) {
+            break;
+        }
+
+        // before the first byte only vmin 0 has a timeout, after it the timer restarts with each wakeup
+        uint32_t timeout = BUFFEREDSERIAL2_WAIT_FOREVER;
+        if (m_rx_vtime != 0 && (m_rx_vmin == 0 || ptr != (char*)buffer)) {
+            timeout = m_rx_vtime;
+        }
+        if (!BufferedSerial2Port::waitEvents(RxDataFlag, timeout)) {
+            rxFetch();
+            popped = _rxbuf.pop(ptr, end - ptr);
+            ptr += popped;
+            rxRelease(popped);
+            break;
+        }
+    }
+    _rx_waiting = false;
+
+    if (ptr == (char*)buffer) {
+        return -EAGAIN;
+    }
+    return ptr - (char*)buffer;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::rxIrq(void)
+{
+    char *first = NULL;
+    char *second = NULL;
+    size_t first_length = 0;
+    size_t second_length = 0;
+    size_t space = _rxbuf.reserve(SIZE_MAX, first, first_length, second, second_length);
+    size_t received = 0;
+    size_t count = 0;
+    bool delimited = false;
+
+    // empty the hardware fifo into the free space and publish it in one go
+    while(serial_readable(&_serial)) {
+        char c = serial_getc(&_serial);
+        count++;
+        delimited |= (c == (char)m_rx_delimiter) && (m_rx_delimiter >= 0);
+        if (received == space) {
+            // out of room: the rx buffer's overflow policy decides which byte is lost
+            _rxbuf.commit(received);
+            received = space = 0;
+            _rxbuf.push(c);
+        } else if (received < first_length) {
+            first[received++] = c;
+        } else {
+            second[(received++) - first_length] = c;
+        }
+    }
+    _rxbuf.commit(received);
+
+    BUFFEREDSERIAL2_STAT_ADD(rx_bytes, count);
+    BUFFEREDSERIAL2_STAT_ADD(rx_irqs, 1);
+    if (count != 0) {
+        BUFFEREDSERIAL2_LATENCY_IN(_rx_latency, _rxbuf);
+        // only pay for the wakeup when a reader is actually sleeping
+        if (_rx_waiting) {
+            BufferedSerial2Port::setEvents(RxDataFlag);
+        }
+        BufferedSerial2Port::rxNotify(delimited);
+    }
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::sigio(mbed::Callback<void()> func)
+{
+    BUFFEREDSERIAL2_CRITICAL_ENTER(Settings);
+    _sigio = func;
+    _rx_signalled = false;
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::set_rx_notify(size_t threshold, int delimiter, uint32_t coalesce_us)
+{
+    BUFFEREDSERIAL2_CRITICAL_ENTER(Settings);
+    m_rx_threshold = threshold ? threshold : 1;
+    m_rx_delimiter = delimiter;
+    m_rx_coalesce_us = coalesce_us;
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+BufferedSerial2Stats BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::get_stats() const
+{
+    BufferedSerial2Stats stats;
+
+    memset(&stats, 0, sizeof(stats));
+#if BUFFEREDSERIAL2_STATS
+    // counters only grow, so the difference to the base is safe against wraparound and needs no lock
+    stats.rx_bytes = _stats.rx_bytes - _stats_base.rx_bytes;
+    stats.tx_bytes = _stats.tx_bytes - _stats_base.tx_bytes;
+    stats.rx_irqs = _stats.rx_irqs - _stats_base.rx_irqs;
+    stats.tx_irqs = _stats.tx_irqs - _stats_base.tx_irqs;
+    stats.rx_errors = _stats.rx_errors - _stats_base.rx_errors;
+    stats.tx_blocked_us = _stats.tx_blocked_us - _stats_base.tx_blocked_us;
+    stats.tx_drain_us = _stats.tx_drain_us - _stats_base.tx_drain_us;
+#endif
+    stats.rx_dropped = _rxbuf.dropped();
+    stats.tx_dropped = _txbuf.dropped();
+
+    return stats;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::reset_stats()
+{
+#if BUFFEREDSERIAL2_STATS
+    _stats_base = _stats;
+#endif
+    BufferedSerial2Port::reset_dropped();
+
+    return;
+}
+
+namespace BufferedSerial2Impl {
+
+template<typename Buffer>
+BufferedSerial2Sizing buffer_sizing(const Buffer &buf, uint32_t target_loss_ppm)
+{
+    BufferedSerial2Sizing sizing;
+    uint32_t above = 1;
+
+    sizing.capacity = buf.capacity();
+    sizing.high_water = buf.high_water();
+    sizing.dropped = buf.dropped();
+    while (above && above <= sizing.capacity) {
+        above <<= 1;
+    }
+#if CIRCULARBUFFER2_HISTOGRAM
+    uint64_t total = sizing.dropped;
+    for (unsigned b = 0; b < Buffer::histogram_buckets; b++) {
+        total += buf.histogram(b);
+    }
+    if (total == 0) {
+        sizing.recommended = 0;
+        return sizing;
+    }
+    uint64_t allowed = total * target_loss_ppm / 1000000;
+    if (sizing.dropped > allowed) {
+        sizing.recommended = above;
+        return sizing;
+    }
+    // a buffer of 2^b holds everything pushed at levels up to 2^b, that is in buckets up to b
+    uint64_t lost = 0;
+    unsigned b = Buffer::histogram_buckets - 1;
+    while (b > 0 && lost + buf.histogram(b) <= allowed) {
+        lost += buf.histogram(b);
+        b--;
+    }
+    sizing.recommended = (uint32_t)1 << b;
+#else
+    sizing.recommended = sizing.dropped ? above : sizing.high_water;
+#endif
+
+    return sizing;
+}
+
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+BufferedSerial2Sizing BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::get_rx_sizing(uint32_t target_loss_ppm) const
+{
+    return BufferedSerial2Impl::buffer_sizing(_rxbuf, target_loss_ppm);
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+BufferedSerial2Sizing BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::get_tx_sizing(uint32_t target_loss_ppm) const
+{
+    return BufferedSerial2Impl::buffer_sizing(_txbuf, target_loss_ppm);
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::reset_sizing()
+{
+    _rxbuf.reset_occupancy();
+    _txbuf.reset_occupancy();
+    BufferedSerial2Port::reset_dropped();
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+BufferedSerial2Latency BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::get_rx_latency() const
+{
+#if BUFFEREDSERIAL2_LATENCY
+    return latencyReport(_rx_latency);
+#else
+    BufferedSerial2Latency latency;
+    memset(&latency, 0, sizeof(latency));
+    return latency;
+#endif
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+BufferedSerial2Latency BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::get_tx_latency() const
+{
+#if BUFFEREDSERIAL2_LATENCY
+    return latencyReport(_tx_latency);
+#else
+    BufferedSerial2Latency latency;
+    memset(&latency, 0, sizeof(latency));
+    return latency;
+#endif
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::reset_latency()
+{
+#if BUFFEREDSERIAL2_LATENCY
+    BUFFEREDSERIAL2_CRITICAL_ENTER(Settings);
+    _rx_latency.active = false;
+    _rx_latency.histogram.reset();
+    _tx_latency.active = false;
+    _tx_latency.histogram.reset();
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+#endif
+
+    return;
+}
+
+#if BUFFEREDSERIAL2_LATENCY
+template<typename RxBufferIndex, typename TxBufferIndex>
+template<typename Buffer>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::latencyIn(LatencyProbe &probe, const Buffer &buf)
+{
+    if (probe.active) {
+        return;
+    }
+    // the level and the start must be taken together, or the reader could take the byte out in between
+    BUFFEREDSERIAL2_CRITICAL_ENTER(Latency);
+    size_t level = buf.size();
+    if (!probe.active && level != 0) {
+        probe.start = mbed::CycleCounter::read();
+        probe.ahead = level;
+        probe.active = true;
+    }
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::latencyOut(LatencyProbe &probe, size_t length)
+{
+    if (!probe.active || length == 0) {
+        return;
+    }
+    if (length < probe.ahead) {
+        probe.ahead -= length;
+        return;
+    }
+    probe.histogram.record(mbed::CycleCounter::read() - probe.start);
+    probe.active = false;
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+BufferedSerial2Latency BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::latencyReport(const LatencyProbe &probe)
+{
+    BufferedSerial2Latency latency;
+
+    latency.samples = probe.histogram.count();
+    latency.p50 = probe.histogram.percentile(500000);
+    latency.p99 = probe.histogram.percentile(990000);
+    latency.p999 = probe.histogram.percentile(999000);
+    latency.max = probe.histogram.max();
+    latency.ticks_hz = mbed::CycleCounter::hz();
+
+    return latency;
+}
+#endif
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::rxNotify(bool delimited)
+{
+    if (!_sigio || _rx_signalled) {
+        return;
+    }
+
+    // from the receiving side, which owns the head index
+    size_t room = m_rx_threshold < _rxbuf.capacity() ? _rxbuf.capacity() - m_rx_threshold : 0;
+    if (delimited || _rxbuf.space(room + 1) <= room) {
+        if (_rx_coalescing) {
+            _rx_coalesce.detach();
+            _rx_coalescing = false;
+        }
+        _rx_signalled = true;
+        _sigio();
+    } else if (m_rx_coalesce_us != 0 && !_rx_coalescing) {
+        // below the threshold: give the rest of the burst a chance to arrive
+        _rx_coalescing = true;
+        _rx_coalesce.attach_us(mbed::callback(this, &BufferedSerial2Port::rxCoalesced), m_rx_coalesce_us);
+    }
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::rxCoalesced(void)
+{
+    _rx_coalescing = false;
+    if (_sigio && !_rx_signalled && _rxbuf.space() < _rxbuf.capacity()) {
+        _rx_signalled = true;
+        _sigio();
+    }
+
+    return;
+}
+
+#if !BUFFEREDSERIAL2_TX_DMA
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::txIrq(void)
+{
+    size_t sent = 0;
+
+    // see if there is room in the hardware fifo and if something is in the software fifo
+    while(serial_writable(&_serial)) {
+        char c = 0;
+        if (_txbuf.pop(c)) {
+            serial_putc(&_serial, (int)c);
+            sent++;
+            continue;
+        }
+        // nothing left to send: go idle, then look again, as a writer that
+        // pushed before the state changed saw TxActive and didn't prime()
+        BufferedSerial2Port::txIrqEnable(false);
+        core_util_atomic_store_u8(&_tx_state, TxIdle);
+        uint8_t idle = TxIdle;
+        if (_txbuf.available(1) == 0 || !core_util_atomic_cas_u8(&_tx_state, &idle, TxActive)) {
+            break;
+        }
+        BufferedSerial2Port::txIrqEnable(true);
+    }
+
+#if BUFFEREDSERIAL2_STATS
+    if (core_util_is_isr_active()) {
+        BUFFEREDSERIAL2_STAT_ADD(tx_irqs, 1);   // not when called from prime()
+    }
+    BUFFEREDSERIAL2_STAT_ADD(tx_bytes, sent);
+#endif
+    BUFFEREDSERIAL2_LATENCY_OUT(_tx_latency, sent);
+    if (sent) {
+        BufferedSerial2Port::txNotify();
+    }
+
+    return;
+}
+#endif
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::txStart(void)
+{
+#if BUFFEREDSERIAL2_TX_DMA
+    BufferedSerial2Port::txDmaStart();
+#else
+    // prime() found tx idle, fill the fifo right away, the masked interrupt can't run txIrq() at the same time
+    BUFFEREDSERIAL2_PRIME_ENTER();
+    if (_tx_state == TxIdle) {
+        _tx_state = TxActive;
+        BufferedSerial2Port::txIrq();
+        if (_tx_state == TxActive) {
+            BufferedSerial2Port::txIrqEnable(true);
+        }
+    }
+    BUFFEREDSERIAL2_PRIME_EXIT();
+#endif
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::setEvents(uint32_t flags)
+{
+#if MBED_CONF_RTOS_PRESENT
+    _events.set(flags);
+#else
+    BUFFEREDSERIAL2_CRITICAL_ENTER(Events);
+    _events |= flags;
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+#endif
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::clearEvents(uint32_t flags)
+{
+#if MBED_CONF_RTOS_PRESENT
+    _events.clear(flags);
+#else
+    BUFFEREDSERIAL2_CRITICAL_ENTER(Events);
+    _events &= ~flags;
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+#endif
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+bool BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::waitEvents(uint32_t flags, uint32_t timeout_ms)
+{
+#if MBED_CONF_RTOS_PRESENT
+    // threads sleep, interrupt handlers can't and fall through to the spin below
+    if (!core_util_is_isr_active()) {
+        return (_events.wait_any(flags, timeout_ms) & osFlagsError) == 0;
+    }
+    uint32_t start = us_ticker_read();
+    while ((_events.get() & flags) == 0) {
+#else
+    uint32_t start = us_ticker_read();
+    while ((_events & flags) == 0) {
+#endif
+        if (timeout_ms != BUFFEREDSERIAL2_WAIT_FOREVER && (us_ticker_read() - start) / 1000 >= timeout_ms) {
+            return false;
+        }
+    }
+    BufferedSerial2Port::clearEvents(flags);
+
+    return true;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+bool BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::txWait(bool drain)
+{
+    uint32_t flag = drain ? TxEmptyFlag : TxSpaceFlag;
+    size_t resume = drain ? 0 : m_tx_low;
+
+    bool done = true;
+
+    if (!drain && !txAbove(m_tx_high - 1)) {
+        return true;
+    }
+#if BUFFEREDSERIAL2_STATS
+    uint32_t start = us_ticker_read();
+#endif
+    // announce the wait before checking again, so txNotify() can't skip the wakeup
+    core_util_atomic_incr_u32(&_tx_waiting, 1);
+    while (txAbove(resume)) {
+        BufferedSerial2Port::prime();   // the buffer can only drain if tx is running
+        BufferedSerial2Port::clearEvents(flag);
+        // check again now that the flag is clear, so a wakeup from the irq in between isn't lost
+        if (!txAbove(resume)) {
+            break;
+        }
+        if (!BufferedSerial2Port::waitEvents(flag, m_tx_timeout)) {
+            done = false;
+            break;
+        }
+    }
+    // txNotify() sets the flag once and the wait cleared it for this thread only, pass it on
+    if (core_util_atomic_decr_u32(&_tx_waiting, 1) != 0 && done) {
+        BufferedSerial2Port::setEvents(flag);
+    }
+#if BUFFEREDSERIAL2_STATS
+    if (drain) {
+        BUFFEREDSERIAL2_STAT_ADD(tx_drain_us, us_ticker_read() - start);
+    } else {
+        BUFFEREDSERIAL2_STAT_ADD(tx_blocked_us, us_ticker_read() - start);
+    }
+#endif
+
+    return done;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::txNotify(void)
+{
+    // only pay for the wakeup when a writer is actually sleeping
+    if (core_util_atomic_load_u32(&_tx_waiting) == 0) {
+        return;
+    }
+    // wake writers only once the buffer is down to the low watermark, or empty for sync(),
+    // the level is exact there and the writer's head index isn't loaded above it
+    size_t level = _txbuf.available(m_tx_low + 1);
+    if (level <= m_tx_low) {
+        BufferedSerial2Port::setEvents(level == 0 ? (TxSpaceFlag | TxEmptyFlag) : TxSpaceFlag);
+    }
+
+    return;
+}
+
+#if BUFFEREDSERIAL2_TX_DMA
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::txDmaStart(void)
+{
+    const char *data = NULL;
+    size_t length = 0;
+
+    // only one of the writing thread and the completion irq may start the next transfer
+    BUFFEREDSERIAL2_CRITICAL_ENTER(TxDma);
+    if (_tx_dma_length == 0) {
+        data = _txbuf.peek_contiguous(length);
+        _tx_dma_length = length;
+    }
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+
+    if (length > 0) {
+        if (SerialBase::write((const uint8_t *)data, length, mbed::callback(this, &BufferedSerial2Port::txDmaDone), SERIAL_EVENT_TX_COMPLETE) != 0) {
+            // peripheral busy, e.g. still finishing the transfer whose completion
+            // called us: retry by ourselves, a sleeping writer waits for that
+            _tx_dma_length = 0;
+            _tx_dma_retry.attach_us(mbed::callback(this, &BufferedSerial2Port::txDmaStart), BUFFEREDSERIAL2_TX_DMA_RETRY_US);
+        }
+    }
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::txDmaDone(int event)
+{
+    // the transferred bytes stay in the buffer until the DMA is done reading them,
+    // which is why the tx buffer never overwrites its oldest bytes
+    BUFFEREDSERIAL2_STAT_ADD(tx_irqs, 1);
+    BUFFEREDSERIAL2_STAT_ADD(tx_bytes, _tx_dma_length);
+    BUFFEREDSERIAL2_LATENCY_OUT(_tx_latency, _tx_dma_length);
+    _txbuf.consume(_tx_dma_length);
+    _tx_dma_length = 0;
+    BufferedSerial2Port::txNotify();
+    BufferedSerial2Port::txDmaStart();
+
+    return;
+}
+#endif
+
+#if BUFFEREDSERIAL2_RX_DMA
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::rxDmaStart(void)
+{
+    char *first = NULL;
+    char *second = NULL;
+    size_t length = 0;
+    size_t second_length = 0;
+    size_t wanted = SIZE_MAX;
+
+    // only one of the reading thread and the completion irq may start the next transfer
+    BUFFEREDSERIAL2_CRITICAL_ENTER(RxDma);
+    if (_rx_dma_length == 0) {
+#if BUFFEREDSERIAL2_RX_DMA_POLL_US
+        // between frames a single byte waits for the next one, its completion starts the burst
+        wanted = _rx_dma_burst ? SIZE_MAX : 1;
+        _rx_dma_polled = 0;
+#endif
+        _rxbuf.reserve(wanted, first, length, second, second_length);
+        _rx_dma_length = length;
+        _rx_dma_committed = 0;
+    }
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+
+    // when the buffer is full the transfer is restarted once a reader makes room
+    if (length > 0) {
+        // a delimited frame ends the transfer, so its completion publishes it
+        unsigned char match = m_rx_delimiter >= 0 ? (unsigned char)m_rx_delimiter : SERIAL_RESERVED_CHAR_MATCH;
+        if (SerialBase::read((uint8_t *)first, length, mbed::callback(this, &BufferedSerial2Port::rxDmaDone), SERIAL_EVENT_RX_ALL, match) != 0) {
+            _rx_dma_length = 0;
+        }
+#if BUFFEREDSERIAL2_RX_DMA_POLL_US
+        else if (wanted != 1) {
+            _rx_dma_poll.attach_us(mbed::callback(this, &BufferedSerial2Port::rxDmaPoll), BUFFEREDSERIAL2_RX_DMA_POLL_US);
+        }
+#endif
+    }
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::rxDmaDone(int event)
+{
+    BUFFEREDSERIAL2_CRITICAL_ENTER(RxDma);
+    size_t received = (event & SERIAL_EVENT_RX_COMPLETE) ? _rx_dma_length : _serial.rx_buff.pos;
+    if (received > _rx_dma_committed) {
+        _rxbuf.commit(received - _rx_dma_committed);
+        BUFFEREDSERIAL2_STAT_ADD(rx_bytes, received - _rx_dma_committed);
+        BUFFEREDSERIAL2_LATENCY_IN(_rx_latency, _rxbuf);
+    }
+#if BUFFEREDSERIAL2_RX_DMA_POLL_US
+    _rx_dma_burst = _rx_dma_burst || received != 0;
+#endif
+    _rx_dma_length = 0;
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+
+    BUFFEREDSERIAL2_STAT_ADD(rx_irqs, 1);
+    if (event & (SERIAL_EVENT_RX_OVERRUN_ERROR | SERIAL_EVENT_RX_FRAMING_ERROR | SERIAL_EVENT_RX_PARITY_ERROR)) {
+        BUFFEREDSERIAL2_STAT_ADD(rx_errors, 1);
+    }
+
+    if (_rx_waiting) {
+        BufferedSerial2Port::setEvents(RxDataFlag);
+    }
+    BufferedSerial2Port::rxNotify((event & SERIAL_EVENT_RX_CHARACTER_MATCH) != 0);
+
+    // errors end the transfer too, keep receiving
+    BufferedSerial2Port::rxDmaStart();
+
+    return;
+}
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+bool BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::rxDmaSync(void)
+{
+    bool any = false;
+
+    // publish the part of the running transfer the HAL reports as received, so
+    // readers don't have to wait for the whole transfer. rx_buff.pos is what the
+    // asynch HALs advance as the transfer fills
+    BUFFEREDSERIAL2_CRITICAL_ENTER(RxDma);
+    if (_rx_dma_length != 0) {
+        size_t received = _serial.rx_buff.pos;
+        if (received > _rx_dma_committed) {
+            _rxbuf.commit(received - _rx_dma_committed);
+            BUFFEREDSERIAL2_STAT_ADD(rx_bytes, received - _rx_dma_committed);
+            BUFFEREDSERIAL2_LATENCY_IN(_rx_latency, _rxbuf);
+            _rx_dma_committed = received;
+            any = true;
+        }
+    }
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+
+    return any;
+}
+
+#if BUFFEREDSERIAL2_RX_DMA_POLL_US
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::rxDmaPoll(void)
+{
+    BUFFEREDSERIAL2_CRITICAL_ENTER(RxDma);
+    bool arriving = _rx_dma_length != 0 && _serial.rx_buff.pos != _rx_dma_polled;
+    if (arriving) {
+        _rx_dma_polled = _serial.rx_buff.pos;
+    } else if (_rx_dma_length != 0) {
+        // a whole period without a byte, the frame is over: end the transfer where it got to
+        SerialBase::abort_read();
+    }
+    bool published = BufferedSerial2Port::rxDmaSync();
+    if (!arriving) {
+        _rx_dma_burst = false;
+        _rx_dma_length = 0;
+    }
+    BUFFEREDSERIAL2_CRITICAL_EXIT();
+
+    // a frame shorter than the transfer doesn't complete it, announce it from here
+    if (published) {
+        if (_rx_waiting) {
+            BufferedSerial2Port::setEvents(RxDataFlag);
+        }
+        BufferedSerial2Port::rxNotify(false);
+    }
+
+    if (arriving) {
+        _rx_dma_poll.attach_us(mbed::callback(this, &BufferedSerial2Port::rxDmaPoll), BUFFEREDSERIAL2_RX_DMA_POLL_US);
+    } else {
+        BufferedSerial2Port::rxDmaStart();
+    }
+
+    return;
+}
+#endif
+
+template<typename RxBufferIndex, typename TxBufferIndex>
+void BufferedSerial2Port<RxBufferIndex, TxBufferIndex>::rx_idle(void)
+{
+    if (BufferedSerial2Port::rxDmaSync()) {
+        if (_rx_waiting) {
+            BufferedSerial2Port::setEvents(RxDataFlag);
+        }
+        BufferedSerial2Port::rxNotify(false);
+    }
+
+    return;
+}
+#endif
+
+#undef BUFFEREDSERIAL2_STAT_ADD
+#undef BUFFEREDSERIAL2_CRITICAL_ENTER
+#undef BUFFEREDSERIAL2_CRITICAL_EXIT
+#undef BUFFEREDSERIAL2_PRIME_ENTER
+#undef BUFFEREDSERIAL2_PRIME_EXIT
+#undef BUFFEREDSERIAL2_LATENCY_IN
+#undef BUFFEREDSERIAL2_LATENCY_OUT
+
+#endif
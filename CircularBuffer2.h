@@ -18,8 +18,39 @@
 #define MBED_CIRCULARBUFFER2_H
 
 #include <stdint.h>
+#include <string.h>
 #include "platform/mbed_critical.h"
 #include "platform/mbed_assert.h"
+#include "platform/mbed_toolchain.h"
+#include "mbed_version.h"
+
+// the lock-free policies need core_util_atomic_load/store_*(), new in Mbed OS 5.12
+#if !((MBED_MAJOR_VERSION == 5) && (MBED_MINOR_VERSION >= 12))
+#error "CircularBuffer2 requires use of Mbed OS 5.12.0 and newer"
+#endif
+
+// Cores with BASEPRI, for CircularBuffer2BasePriority
+#if defined(__MBED__) && (defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__) || defined(__ARM_ARCH_8_1M_MAIN__))
+#include "cmsis.h"
+#define CIRCULARBUFFER2_BASEPRI 1
+#else
+#define CIRCULARBUFFER2_BASEPRI 0
+#endif
+
+// Keep a log2 histogram of the occupancy seen by every push, see CircularBuffer2::histogram()
+#if !defined(CIRCULARBUFFER2_HISTOGRAM)
+#define CIRCULARBUFFER2_HISTOGRAM 0
+#endif
+
+// Track the most elements held at once, see CircularBuffer2::high_water()
+#if !defined(CIRCULARBUFFER2_HIGH_WATER)
+#define CIRCULARBUFFER2_HIGH_WATER 0
+#endif
+
+// Count the elements lost to a full buffer, see CircularBuffer2::dropped()
+#if !defined(CIRCULARBUFFER2_DROPPED)
+#define CIRCULARBUFFER2_DROPPED 1
+#endif
 
 namespace mbed {
 
@@ -30,44 +61,374 @@ namespace mbed {
  * @{
  */
 
+/** Locking policy that guards every operation with a global critical section.
+ *
+ *  Any number of producers and consumers may use the buffer, from thread or
+ *  interrupt context.
+ */
+struct CircularBuffer2CriticalSection {
+    static const bool lock_free = false;
+    static const size_t cache_line_size = 0;
+
+    static void lock()
+    {
+        core_util_critical_section_enter();
+    }
+
+    static void unlock()
+    {
+        core_util_critical_section_exit();
+    }
+};
+
+/** Locking policy that only masks interrupts of Priority and below.
+ *
+ *  On Armv7-M and Armv8-M Mainline cores the lock raises BASEPRI, so more
+ *  urgent interrupts (numerically lower than Priority) keep running while the
+ *  buffer is locked. Every context using the buffer must therefore run at
+ *  Priority or below, in NVIC priority levels. Locks nest within a context.
+ *  Cores without BASEPRI and host builds use the global critical section.
+ *
+ *  @tparam Priority Most urgent priority that uses the buffer, from 1 to (1 << __NVIC_PRIO_BITS) - 1
+ */
+template<uint8_t Priority>
+struct CircularBuffer2BasePriority {
+    static const bool lock_free = false;
+    static const size_t cache_line_size = 0;
+
+    static void lock()
+    {
+#if CIRCULARBUFFER2_BASEPRI
+        uint32_t previous = __get_BASEPRI();
+        __set_BASEPRI_MAX(Priority << (8U - __NVIC_PRIO_BITS));
+        __ISB();
+        // only this context runs until unlock(), everything else that locks is masked now
+        if (depth++ == 0) {
+            saved = previous;
+        }
+#else
+        core_util_critical_section_enter();
+#endif
+    }
+
+    static void unlock()
+    {
+#if CIRCULARBUFFER2_BASEPRI
+        if (--depth == 0) {
+            __set_BASEPRI(saved);
+        }
+#else
+        core_util_critical_section_exit();
+#endif
+    }
+
+private:
+    MBED_STRUCT_STATIC_ASSERT(Priority > 0, "CircularBuffer2BasePriority can't mask priority 0, use CircularBuffer2CriticalSection");
+#if CIRCULARBUFFER2_BASEPRI
+    MBED_STRUCT_STATIC_ASSERT(Priority < (1U << __NVIC_PRIO_BITS), "CircularBuffer2BasePriority priority out of range");
+
+    static uint32_t depth;
+    static uint32_t saved;
+#endif
+};
+
+#if CIRCULARBUFFER2_BASEPRI
+template<uint8_t Priority>
+uint32_t CircularBuffer2BasePriority<Priority>::depth = 0;
+
+template<uint8_t Priority>
+uint32_t CircularBuffer2BasePriority<Priority>::saved = 0;
+#endif
+
+/** Lock-free policy for exactly one producer and one consumer.
+ *
+ *  Indices are published with acquire/release ordering instead of masking
+ *  interrupts. The producer (push) and the consumer (pop, peek) may run in
+ *  different contexts, e.g. an ISR and a thread, but neither side may be
+ *  shared. As the consumer owns the tail, push() can't overwrite the oldest
+ *  element: the overflow policy defaults to CircularBuffer2DropNewest and
+ *  CircularBuffer2OverwriteOldest is not available.
+ */
+struct CircularBuffer2SPSC {
+    static const bool lock_free = true;
+    static const size_t cache_line_size = 0;
+
+    static void lock()
+    {
+    }
+
+    static void unlock()
+    {
+    }
+};
+
+/** What a CircularBuffer2 does with elements pushed while it is full
+ */
+enum CircularBuffer2Overflow {
+    CircularBuffer2OverwriteOldest,     /**< Make room by discarding the oldest element, needs a locking policy */
+    CircularBuffer2DropNewest,          /**< Discard the new element, push() still reports it as accepted */
+    CircularBuffer2Reject               /**< Discard the new element, push() reports it as not accepted */
+};
+
+/** Lock-free policy for one producer and one consumer running on different
+ *  cores (or host threads).
+ *
+ *  Producer and consumer state sit on separate cache lines, and each side
+ *  keeps a private copy of the other side's index. The copy is only reloaded
+ *  when it says the buffer is full (or empty), so the lines move between
+ *  cores once per batch instead of once per element.
+ */
+template<size_t CacheLineSize = 32>
+struct CircularBuffer2SPSCCacheAligned : CircularBuffer2SPSC {
+    static const size_t cache_line_size = CacheLineSize;
+};
+
+/** Head and tail of a CircularBuffer2, with the producer and consumer sides on
+ *  their own cache lines
+ */
+template<typename CounterType, size_t CacheLineSize>
+struct CircularBuffer2Indices {
+    MBED_ALIGN(CacheLineSize) volatile CounterType head;
+    CounterType tail_cache;     // producer's view of tail
+    MBED_ALIGN(CacheLineSize) volatile CounterType tail;
+    CounterType head_cache;     // consumer's view of head
+
+    void clear()
+    {
+        head = 0;
+        tail_cache = 0;
+        tail = 0;
+        head_cache = 0;
+    }
+};
+
+/** Head and tail of a CircularBuffer2, packed together
+ */
+template<typename CounterType>
+struct CircularBuffer2Indices<CounterType, 0> {
+    volatile CounterType head;
+    volatile CounterType tail;
+
+    void clear()
+    {
+        head = 0;
+        tail = 0;
+    }
+};
+
+/** Index policy for any capacity.
+ *
+ *  Head and tail run over [0, 2 * BufferSize) so that a full buffer can be
+ *  told apart from an empty one without a shared flag. Wrapping costs a
+ *  compare per index update.
+ */
+class CircularBuffer2AnySize {
+public:
+    static const size_t static_capacity = 0;
+
+    CircularBuffer2AnySize(size_t buffer_size) : BufferSize(buffer_size)
+    {
+        MBED_ASSERT(buffer_size > 0 && buffer_size <= (UINT32_MAX / 2));
+    }
+
+    size_t capacity() const
+    {
+        return BufferSize;
+    }
+
+    uint32_t slot(uint32_t index) const
+    {
+        return index < BufferSize ? index : index - BufferSize;
+    }
+
+    uint32_t advance(uint32_t index, uint32_t n) const
+    {
+        index += n;
+        return index < 2 * BufferSize ? index : index - 2 * BufferSize;
+    }
+
+    uint32_t used(uint32_t head, uint32_t tail) const
+    {
+        return head >= tail ? head - tail : 2 * BufferSize + head - tail;
+    }
+
+private:
+    size_t BufferSize;
+};
+
+/** Index policy for power-of-two capacities.
+ *
+ *  Head and tail run freely and are masked into the pool, so advancing an
+ *  index and computing the number of stored elements are branch free.
+ */
+class CircularBuffer2PowerOfTwo {
+public:
+    static const size_t static_capacity = 0;
+
+    CircularBuffer2PowerOfTwo(size_t buffer_size) : _mask(buffer_size - 1)
+    {
+        MBED_ASSERT(buffer_size > 0 && (buffer_size & (buffer_size - 1)) == 0 && buffer_size <= (UINT32_MAX / 2) + 1);
+    }
+
+    size_t capacity() const
+    {
+        return (size_t)_mask + 1;
+    }
+
+    uint32_t slot(uint32_t index) const
+    {
+        return index & _mask;
+    }
+
+    uint32_t advance(uint32_t index, uint32_t n) const
+    {
+        return index + n;
+    }
+
+    uint32_t used(uint32_t head, uint32_t tail) const
+    {
+        return head - tail;
+    }
+
+private:
+    uint32_t _mask;
+};
+
+/** Index policy for a capacity fixed at compile time.
+ *
+ *  The capacity is a constant the compiler folds into every index update,
+ *  using mask arithmetic when N is a power of two and the [0, 2 * N) scheme
+ *  of CircularBuffer2AnySize otherwise.
+ */
+template<size_t N>
+class CircularBuffer2FixedSize {
+public:
+    static const size_t static_capacity = N;
+
+    CircularBuffer2FixedSize(size_t buffer_size)
+    {
+        MBED_ASSERT(buffer_size == N);
+    }
+
+    size_t capacity() const
+    {
+        return N;
+    }
+
+    uint32_t slot(uint32_t index) const
+    {
+        if (power_of_two) {
+            return index & (N - 1);
+        }
+        return index < N ? index : index - N;
+    }
+
+    uint32_t advance(uint32_t index, uint32_t n) const
+    {
+        if (power_of_two) {
+            return index + n;
+        }
+        index += n;
+        return index < 2 * N ? index : index - 2 * N;
+    }
+
+    uint32_t used(uint32_t head, uint32_t tail) const
+    {
+        if (power_of_two) {
+            return head - tail;
+        }
+        return head >= tail ? head - tail : 2 * N + head - tail;
+    }
+
+private:
+    MBED_STRUCT_STATIC_ASSERT(N > 0 && N <= (UINT32_MAX / 2) + 1, "CircularBuffer2FixedSize: N must be between 1 and 2^31");
+
+    static const bool power_of_two = (N & (N - 1)) == 0;
+};
+
 /** Templated Circular buffer class
  *
- *  @note Synchronization level: Interrupt safe
- *  @note CounterType must be unsigned and consistent with BufferSize
+ *  @note Synchronization level: Interrupt safe with CircularBuffer2CriticalSection,
+ *        single producer / single consumer with CircularBuffer2SPSC
+ *  @note CounterType must be uint8_t, uint16_t or uint32_t, and able to count
+ *        up to twice the capacity. A narrow type saves RAM on small buffers
  */
-template<typename T>
-class CircularBuffer2 {
+template<typename T, typename SyncPolicy = CircularBuffer2CriticalSection, typename IndexPolicy = CircularBuffer2AnySize, typename CounterType = uint32_t>
+class CircularBuffer2 : private IndexPolicy {
 public:
-    CircularBuffer2(T *pool, size_t buffer_size) : _pool(pool), BufferSize(buffer_size), _head(0), _tail(0), _full(false)
+    CircularBuffer2(T *pool, size_t buffer_size) : IndexPolicy(buffer_size), _pool(pool),
+        _overflow(SyncPolicy::lock_free ? CircularBuffer2DropNewest : CircularBuffer2OverwriteOldest)
     {
+        MBED_ASSERT(IndexPolicy::capacity() <= max_capacity);
+        _indices.clear();
+#if CIRCULARBUFFER2_DROPPED
+        _dropped = 0;
+#endif
+#if CIRCULARBUFFER2_HIGH_WATER
+        _high_water = 0;
+#endif
+#if CIRCULARBUFFER2_HISTOGRAM
+        memset((void *)_histogram, 0, sizeof(_histogram));
+#endif
     }
 
     ~CircularBuffer2()
     {
     }
 
-    /** Push the transaction to the buffer. This overwrites the buffer if it's
-     *  full
+    /** Push the transaction to the buffer. If the buffer is full the overflow
+     *  policy decides what is discarded, see set_overflow()
      *
      * @param data Data to be pushed to the buffer
+     * @return False if the buffer is full and the policy is CircularBuffer2Reject, true otherwise
      */
-    void push(const T &data)
+    bool push(const T &data)
     {
-        core_util_critical_section_enter();
-        if (full()) {
-            _tail++;
-            if (_tail == BufferSize) {
-                _tail = 0;
+        SyncPolicy::lock();
+        uint32_t head = _indices.head;
+        size_t space = free_space(head, 1);
+        if (space == 0) {
+#if CIRCULARBUFFER2_DROPPED
+            _dropped = _dropped + 1;
+#endif
+            if (_overflow != CircularBuffer2OverwriteOldest) {
+                SyncPolicy::unlock();
+                return _overflow == CircularBuffer2DropNewest;
             }
+            store_index(&_indices.tail, advance(load_index(&_indices.tail), 1));
         }
-        _pool[_head++] = data;
-        if (_head == BufferSize) {
-            _head = 0;
-        }
-        if (_head == _tail) {
-            _full = true;
+        // only what is stored is sampled, the dropped count has the rest
+        record(IndexPolicy::capacity() - space + (space != 0), 1);
+        _pool[slot(head)] = data;
+        store_index(&_indices.head, advance(head, 1));
+        SyncPolicy::unlock();
+        return true;
+    }
+
+    /** Push a block of elements to the buffer. Unlike the single element
+     *  push, this never overflows: copying stops when the buffer is full and
+     *  the caller decides what to do with the rest
+     *
+     * @param src Elements to be pushed to the buffer
+     * @param n Number of elements in src
+     * @return Number of elements pushed
+     * @note T must be trivially copyable
+     */
+    size_t push(const T *src, size_t n)
+    {
+        SyncPolicy::lock();
+        uint32_t head = _indices.head;
+        size_t space = free_space(head, n);
+        if (n > space) {
+            n = space;
         }
-        core_util_critical_section_exit();
+        record(IndexPolicy::capacity() - space + n, n);
+        size_t length = contiguous(head, n);
+        memcpy(&_pool[slot(head)], src, length * sizeof(T));
+        memcpy(&_pool[0], src + length, (n - length) * sizeof(T));
+        store_index(&_indices.head, advance(head, n));
+        SyncPolicy::unlock();
+        return n;
     }
 
     /** Pop the transaction from the buffer
@@ -78,29 +439,124 @@ public:
     bool pop(T &data)
     {
         bool data_popped = false;
-        core_util_critical_section_enter();
-        if (!empty()) {
-            data = _pool[_tail++];
-            if (_tail == BufferSize) {
-                _tail = 0;
-            }
-            _full = false;
+        SyncPolicy::lock();
+        uint32_t tail = _indices.tail;
+        if (stored(tail, 1) != 0) {
+            data = _pool[slot(tail)];
+            store_index(&_indices.tail, advance(tail, 1));
             data_popped = true;
         }
-        core_util_critical_section_exit();
+        SyncPolicy::unlock();
         return data_popped;
     }
 
+    /** Pop a block of elements from the buffer
+     *
+     * @param dst Destination for the popped elements
+     * @param n Maximum number of elements to pop
+     * @return Number of elements popped
+     * @note T must be trivially copyable
+     */
+    size_t pop(T *dst, size_t n)
+    {
+        SyncPolicy::lock();
+        uint32_t tail = _indices.tail;
+        size_t elements = stored(tail, n);
+        if (n > elements) {
+            n = elements;
+        }
+        size_t length = contiguous(tail, n);
+        memcpy(dst, &_pool[slot(tail)], length * sizeof(T));
+        memcpy(dst + length, &_pool[0], (n - length) * sizeof(T));
+        store_index(&_indices.tail, advance(tail, n));
+        SyncPolicy::unlock();
+        return n;
+    }
+
+    /** Reserve free space so that up to n elements can be written in place.
+     *  The space may wrap around the end of the pool, in which case it is
+     *  returned as two regions. Nothing is visible to the consumer until commit()
+     *
+     * @param n Number of elements wanted
+     * @param first Set to the start of the first writable region
+     * @param first_length Set to the number of elements in the first region
+     * @param second Set to the start of the pool if the space wraps, NULL otherwise
+     * @param second_length Set to the number of elements in the second region
+     * @return Total number of elements reserved, at most n
+     * @note Only one producer may hold a reservation, and it must not push
+     *       until the reservation is committed
+     */
+    size_t reserve(size_t n, T *&first, size_t &first_length, T *&second, size_t &second_length)
+    {
+        SyncPolicy::lock();
+        uint32_t head = _indices.head;
+        size_t space = free_space(head, n);
+        SyncPolicy::unlock();
+        if (n > space) {
+            n = space;
+        }
+        first = &_pool[slot(head)];
+        first_length = contiguous(head, n);
+        second_length = n - first_length;
+        second = second_length ? &_pool[0] : NULL;
+        return n;
+    }
+
+    /** Publish elements written in place after reserve()
+     *
+     * @param n Number of elements to publish, at most the amount reserved
+     */
+    void commit(size_t n)
+    {
+        SyncPolicy::lock();
+        uint32_t head = _indices.head;
+        size_t space = free_space(head, n);
+        MBED_ASSERT(n <= space);
+        record(IndexPolicy::capacity() - space + n, n);
+        store_index(&_indices.head, advance(head, n));
+        SyncPolicy::unlock();
+    }
+
+    /** Get the elements that can be read in place, up to the end of the pool.
+     *  Call again after consume() to get the part that wrapped around
+     *
+     * @param length Set to the number of elements readable at the returned address
+     * @return Start of the readable region, valid until consume()
+     * @note Consumer side only. In overwrite mode a producer may replace the
+     *       region when the buffer fills up
+     */
+    const T *peek_contiguous(size_t &length) const
+    {
+        SyncPolicy::lock();
+        uint32_t tail = _indices.tail;
+        length = contiguous(tail, stored(tail, IndexPolicy::capacity()));
+        SyncPolicy::unlock();
+        return &_pool[slot(tail)];
+    }
+
+    /** Drop elements from the buffer after reading them in place
+     *
+     * @param n Number of elements to drop, clamped to the number stored
+     */
+    void consume(size_t n)
+    {
+        SyncPolicy::lock();
+        uint32_t tail = _indices.tail;
+        size_t elements = stored(tail, n);
+        if (n > elements) {
+            n = elements;
+        }
+        store_index(&_indices.tail, advance(tail, n));
+        SyncPolicy::unlock();
+    }
+
     /** Check if the buffer is empty
      *
      * @return True if the buffer is empty, false if not
      */
     bool empty() const
     {
-        core_util_critical_section_enter();
-        bool is_empty = (_head == _tail) && !_full;
-        core_util_critical_section_exit();
-        return is_empty;
+        return size() == 0;
     }
 
     /** Check if the buffer is full
@@ -109,42 +565,144 @@ public:
      */
     bool full() const
     {
-        core_util_critical_section_enter();
-        bool full = _full;
-        core_util_critical_section_exit();
-        return full;
+        return size() == IndexPolicy::capacity();
     }
 
     /** Reset the buffer
      *
+     *  @note Not safe against a concurrent producer or consumer when lock-free
      */
     void reset()
     {
-        core_util_critical_section_enter();
-        _head = 0;
-        _tail = 0;
-        _full = false;
-        core_util_critical_section_exit();
+        SyncPolicy::lock();
+        _indices.clear();
+        SyncPolicy::unlock();
     }
 
     /** Get the number of elements currently stored in the circular_buffer */
     uint32_t size() const
     {
-        core_util_critical_section_enter();
-        uint32_t elements;
-        if (!_full) {
-            if (_head < _tail) {
-                elements = BufferSize + _head - _tail;
-            } else {
-                elements = _head - _tail;
-            }
-        } else {
-            elements = BufferSize;
-        }
-        core_util_critical_section_exit();
+        SyncPolicy::lock();
+        uint32_t tail = load_index(&_indices.tail);
+        uint32_t elements = used(load_index(&_indices.head), tail);
+        SyncPolicy::unlock();
+        return elements;
+    }
+
+    /** Get the free space as the producer sees it. Only the producer may call
+     *  this when lock-free. With CircularBuffer2SPSCCacheAligned the cached
+     *  tail answers without touching the consumer's cache line, unless it
+     *  shows less than wanted
+     *
+     * @param wanted Space the caller is looking for, the result is exact below it
+     * @return The free space, at least wanted if there is that much
+     */
+    size_t space(size_t wanted = SIZE_MAX) const
+    {
+        SyncPolicy::lock();
+        size_t space = free_space(load_index(&_indices.head), wanted);
+        SyncPolicy::unlock();
+        return space;
+    }
+
+    /** Get the number of elements stored as the consumer sees it. Only the
+     *  consumer may call this when lock-free. With CircularBuffer2SPSCCacheAligned
+     *  the cached head answers without touching the producer's cache line,
+     *  unless it shows less than wanted
+     *
+     * @param wanted Elements the caller is looking for, the result is exact below it
+     * @return The number of elements, at least wanted if there are that many
+     */
+    size_t available(size_t wanted = SIZE_MAX) const
+    {
+        SyncPolicy::lock();
+        size_t elements = stored(load_index(&_indices.tail), wanted);
+        SyncPolicy::unlock();
         return elements;
     }
 
+    /** Set what the single element push() does when the buffer is full
+     *
+     * @param policy CircularBuffer2OverwriteOldest (default with a locking policy),
+     *               CircularBuffer2DropNewest (default when lock-free) or CircularBuffer2Reject
+     */
+    void set_overflow(CircularBuffer2Overflow policy)
+    {
+        MBED_ASSERT(!SyncPolicy::lock_free || policy != CircularBuffer2OverwriteOldest);
+        _overflow = policy;
+    }
+
+    /** Get the number of elements discarded because the buffer was full,
+     *  whether overwritten, dropped or rejected. Always 0 without CIRCULARBUFFER2_DROPPED
+     */
+    uint32_t dropped() const
+    {
+#if CIRCULARBUFFER2_DROPPED
+        return core_util_atomic_load_u32(&_dropped);
+#else
+        return 0;
+#endif
+    }
+
+    /** Reset the count of discarded elements */
+    void reset_dropped()
+    {
+#if CIRCULARBUFFER2_DROPPED
+        SyncPolicy::lock();
+        core_util_atomic_store_u32(&_dropped, 0);
+        SyncPolicy::unlock();
+#endif
+    }
+
+    /** Get the most elements the buffer held at once, as seen by the producer.
+     *  Always 0 without CIRCULARBUFFER2_HIGH_WATER
+     */
+    uint32_t high_water() const
+    {
+#if CIRCULARBUFFER2_HIGH_WATER
+        return core_util_atomic_load_u32(&_high_water);
+#else
+        return 0;
+#endif
+    }
+
+#if CIRCULARBUFFER2_HISTOGRAM
+    /** Number of histogram buckets, enough for max_capacity */
+    static const unsigned histogram_buckets = sizeof(CounterType) * 8;
+
+    /** Get the number of elements pushed while the buffer held, including
+     *  them, more than 2^(bucket - 1) and at most 2^bucket elements. Bucket 0
+     *  counts levels of 0 and 1, so a buffer of 2^bucket fits all levels up to
+     *  that bucket
+     *
+     * @param bucket Bucket number, lower than histogram_buckets
+     */
+    uint32_t histogram(unsigned bucket) const
+    {
+        MBED_ASSERT(bucket < histogram_buckets);
+        return core_util_atomic_load_u32(&_histogram[bucket]);
+    }
+#endif
+
+    /** Reset the high water mark and the occupancy histogram */
+    void reset_occupancy()
+    {
+        SyncPolicy::lock();
+#if CIRCULARBUFFER2_HIGH_WATER
+        core_util_atomic_store_u32(&_high_water, 0);
+#endif
+#if CIRCULARBUFFER2_HISTOGRAM
+        memset((void *)_histogram, 0, sizeof(_histogram));
+#endif
+        SyncPolicy::unlock();
+    }
+
+    /** Get the maximum number of elements the buffer can hold */
+    size_t capacity() const
+    {
+        return IndexPolicy::capacity();
+    }
+
     /** Peek into circular buffer without popping
      *
      * @param data Data to be peeked from the buffer
@@ -153,21 +711,160 @@ public:
     bool peek(T &data) const
     {
         bool data_updated = false;
-        core_util_critical_section_enter();
-        if (!empty()) {
-            data = _pool[_tail];
+        SyncPolicy::lock();
+        uint32_t tail = _indices.tail;
+        if (stored(tail, 1) != 0) {
+            data = _pool[slot(tail)];
             data_updated = true;
         }
-        core_util_critical_section_exit();
+        SyncPolicy::unlock();
         return data_updated;
     }
 
 private:
+    // indices span twice the capacity, see the index policies
+    static const size_t max_capacity = ((size_t)(CounterType)(-1) / 2) + 1;
+
+    MBED_STRUCT_STATIC_ASSERT((CounterType)(-1) > 0 && sizeof(CounterType) <= sizeof(uint32_t), "CircularBuffer2: CounterType must be uint8_t, uint16_t or uint32_t");
+    MBED_STRUCT_STATIC_ASSERT(IndexPolicy::static_capacity <= max_capacity, "CircularBuffer2: CounterType too narrow for the capacity");
+    MBED_STRUCT_STATIC_ASSERT(SyncPolicy::cache_line_size == 0 || SyncPolicy::lock_free, "CircularBuffer2: cached indices need a lock-free policy");
+
+    static uint8_t load_index(const volatile uint8_t *index)
+    {
+        return core_util_atomic_load_u8(index);
+    }
+
+    static uint16_t load_index(const volatile uint16_t *index)
+    {
+        return core_util_atomic_load_u16(index);
+    }
+
+    static uint32_t load_index(const volatile uint32_t *index)
+    {
+        return core_util_atomic_load_u32(index);
+    }
+
+    static void store_index(volatile uint8_t *index, uint32_t value)
+    {
+        core_util_atomic_store_u8(index, (uint8_t)value);
+    }
+
+    static void store_index(volatile uint16_t *index, uint32_t value)
+    {
+        core_util_atomic_store_u16(index, (uint16_t)value);
+    }
+
+    static void store_index(volatile uint32_t *index, uint32_t value)
+    {
+        core_util_atomic_store_u32(index, value);
+    }
+
+    // the policies work in 32 bits, truncating to CounterType keeps free running indices modular
+    uint32_t slot(uint32_t index) const
+    {
+        return IndexPolicy::slot(index);
+    }
+
+    uint32_t advance(uint32_t index, uint32_t n) const
+    {
+        return (CounterType)IndexPolicy::advance(index, n);
+    }
+
+    uint32_t used(uint32_t head, uint32_t tail) const
+    {
+        return (CounterType)IndexPolicy::used(head, tail);
+    }
+
+    // free space as seen by the producer, reloading the tail only if the cached copy shows less than wanted
+    size_t free_space(uint32_t head, size_t wanted) const
+    {
+        return free_space(head, wanted, _indices);
+    }
+
+    template<size_t CacheLineSize>
+    size_t free_space(uint32_t head, size_t wanted, CircularBuffer2Indices<CounterType, CacheLineSize> &indices) const
+    {
+        size_t space = IndexPolicy::capacity() - used(head, indices.tail_cache);
+        if (space < wanted) {
+            indices.tail_cache = load_index(&indices.tail);
+            space = IndexPolicy::capacity() - used(head, indices.tail_cache);
+        }
+        return space;
+    }
+
+    size_t free_space(uint32_t head, size_t wanted, CircularBuffer2Indices<CounterType, 0> &indices) const
+    {
+        return IndexPolicy::capacity() - used(head, load_index(&indices.tail));
+    }
+
+    // elements stored as seen by the consumer, reloading the head only if the cached copy shows less than wanted
+    size_t stored(uint32_t tail, size_t wanted) const
+    {
+        return stored(tail, wanted, _indices);
+    }
+
+    template<size_t CacheLineSize>
+    size_t stored(uint32_t tail, size_t wanted, CircularBuffer2Indices<CounterType, CacheLineSize> &indices) const
+    {
+        size_t elements = used(indices.head_cache, tail);
+        if (elements < wanted) {
+            indices.head_cache = load_index(&indices.head);
+            elements = used(indices.head_cache, tail);
+        }
+        return elements;
+    }
+
+    size_t stored(uint32_t tail, size_t wanted, CircularBuffer2Indices<CounterType, 0> &indices) const
+    {
+        return used(load_index(&indices.head), tail);
+    }
+
+    // occupancy sample taken by the producer, n elements were pushed at this level
+    void record(uint32_t level, size_t n)
+    {
+#if CIRCULARBUFFER2_HIGH_WATER
+        if (level > _high_water) {
+            _high_water = level;
+        }
+#endif
+#if CIRCULARBUFFER2_HISTOGRAM
+        _histogram[bucket(level)] += n;
+#endif
+    }
+
+#if CIRCULARBUFFER2_HISTOGRAM
+    static unsigned bucket(uint32_t level)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return level > 1 ? 32 - __builtin_clz(level - 1) : 0;
+#else
+        unsigned b = 0;
+        while (level > ((uint32_t)1 << b)) {
+            b++;
+        }
+        return b;
+#endif
+    }
+#endif
+
+    size_t contiguous(uint32_t index, size_t n) const
+    {
+        size_t length = IndexPolicy::capacity() - slot(index);
+        return length < n ? length : n;
+    }
+
     T *_pool;
-    size_t BufferSize;
-    uint32_t _head;
-    uint32_t _tail;
-    bool _full;
+    mutable CircularBuffer2Indices<CounterType, SyncPolicy::cache_line_size> _indices;
+    uint8_t _overflow;
+#if CIRCULARBUFFER2_DROPPED
+    volatile uint32_t _dropped;     // only the producer increments it
+#endif
+#if CIRCULARBUFFER2_HIGH_WATER
+    volatile uint32_t _high_water;
+#endif
+#if CIRCULARBUFFER2_HISTOGRAM
+    volatile uint32_t _histogram[histogram_buckets];
+#endif
 };
 
 }
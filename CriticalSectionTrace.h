@@ -0,0 +1,147 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_CRITICALSECTIONTRACE_H
+#define MBED_CRITICALSECTIONTRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "platform/mbed_critical.h"
+#include "platform/mbed_assert.h"
+#include "CycleCounter.h"
+#include "LatencyHistogram.h"
+
+// Number of call sites that can be told apart
+#if !defined(CRITICALSECTIONTRACE_SITES)
+#define CRITICALSECTIONTRACE_SITES 8
+#endif
+
+// Sub-bucket bits of the per site histograms, see LatencyHistogram
+#if !defined(CRITICALSECTIONTRACE_PRECISION)
+#define CRITICALSECTIONTRACE_PRECISION 2
+#endif
+
+namespace mbed {
+
+/** \addtogroup platform-public-api */
+/** @{*/
+
+/** Storage of CriticalSectionTrace, a template so the header can define it
+ */
+template<typename Unused = void>
+struct CriticalSectionTraceState {
+    static uint32_t depth;
+    static uint32_t start;
+    static unsigned site;
+    static LatencyHistogram<CRITICALSECTIONTRACE_PRECISION> sites[CRITICALSECTIONTRACE_SITES];
+};
+
+template<typename Unused>
+uint32_t CriticalSectionTraceState<Unused>::depth = 0;
+
+template<typename Unused>
+uint32_t CriticalSectionTraceState<Unused>::start = 0;
+
+template<typename Unused>
+unsigned CriticalSectionTraceState<Unused>::site = 0;
+
+template<typename Unused>
+LatencyHistogram<CRITICALSECTIONTRACE_PRECISION> CriticalSectionTraceState<Unused>::sites[CRITICALSECTIONTRACE_SITES];
+
+/** Critical sections that time how long they keep interrupts masked.
+ *
+ *  A drop-in for core_util_critical_section_enter()/exit() that tags the
+ *  section with a call site. Nested sections are charged to the outermost
+ *  one, which is the time interrupts really stay masked. Durations are in
+ *  CycleCounter ticks and exclude the cost of masking and unmasking itself,
+ *  CycleCounter::start() has to run before.
+ *
+ *  Sections entered without the tracer are not seen, and time spent inside
+ *  them around a traced one is charged to the traced one.
+ */
+class CriticalSectionTrace : private CriticalSectionTraceState<> {
+public:
+    /** Histogram of one site, with its count, max() and total() */
+    typedef LatencyHistogram<CRITICALSECTIONTRACE_PRECISION> Histogram;
+
+    /** Mask interrupts and start timing if this is the outermost section
+     *
+     *  @param site Call site, lower than CRITICALSECTIONTRACE_SITES
+     */
+    static void enter(unsigned site)
+    {
+        MBED_ASSERT(site < CRITICALSECTIONTRACE_SITES);
+        core_util_critical_section_enter();
+        if (depth++ == 0) {
+            CriticalSectionTraceState<>::site = site;
+            start = CycleCounter::read();
+        }
+    }
+
+    /** Record the duration if this is the outermost section, then unmask
+     */
+    static void exit()
+    {
+        if (--depth == 0) {
+            sites[CriticalSectionTraceState<>::site].record(CycleCounter::read() - start);
+        }
+        core_util_critical_section_exit();
+    }
+
+    /** Get the durations recorded for a site
+     *
+     *  @param site Call site, lower than CRITICALSECTIONTRACE_SITES
+     */
+    static const Histogram &histogram(unsigned site)
+    {
+        MBED_ASSERT(site < CRITICALSECTIONTRACE_SITES);
+        return sites[site];
+    }
+
+    /** Forget the durations of all sites
+     */
+    static void reset()
+    {
+        for (unsigned i = 0; i < CRITICALSECTIONTRACE_SITES; i++) {
+            sites[i].reset();
+        }
+    }
+};
+
+/** Locking policy for CircularBuffer2 that guards every operation with a
+ *  traced critical section charged to Site, see CriticalSectionTrace
+ */
+template<unsigned Site>
+struct CircularBuffer2TracedCriticalSection {
+    static const bool lock_free = false;
+    static const size_t cache_line_size = 0;
+
+    static void lock()
+    {
+        CriticalSectionTrace::enter(Site);
+    }
+
+    static void unlock()
+    {
+        CriticalSectionTrace::exit();
+    }
+};
+
+/** @}*/
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_CYCLECOUNTER_H
+#define MBED_CYCLECOUNTER_H
+
+#include <stdint.h>
+
+// Define both to plug in another free running 32 bit counter, CYCLECOUNTER_READ() returning its ticks
+#if defined(CYCLECOUNTER_READ) != defined(CYCLECOUNTER_HZ)
+#error "CYCLECOUNTER_READ and CYCLECOUNTER_HZ must be defined together"
+#endif
+
+#if !defined(CYCLECOUNTER_READ)
+#if defined(__MBED__)
+#include "cmsis.h"
+#include "hal/us_ticker_api.h"
+#else
+#include <chrono>
+#endif
+#endif
+
+namespace mbed {
+
+/** \addtogroup platform-public-api */
+/** @{*/
+
+/** Free running 32 bit timestamp source for measuring short intervals.
+ *
+ *  The core cycle counter (DWT CYCCNT) on Cortex-M cores that have one, the
+ *  microsecond ticker on the others and a steady clock in nanoseconds on the
+ *  host. Differences of two reads are valid across one wraparound.
+ */
+struct CycleCounter {
+    /** Start the counter, harmless when it already runs
+     */
+    static void start()
+    {
+#if !defined(CYCLECOUNTER_READ) && defined(__MBED__) && defined(DWT_CTRL_CYCCNTENA_Msk)
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+#if defined(__CORE_CM7_H_GENERIC)
+        DWT->LAR = 0xC5ACCE55;      // Cortex-M7 locks the DWT registers out of reset
+#endif
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    }
+
+    /** Get the current count
+     */
+    static uint32_t read()
+    {
+#if defined(CYCLECOUNTER_READ)
+        return CYCLECOUNTER_READ();
+#elif defined(__MBED__) && defined(DWT_CTRL_CYCCNTENA_Msk)
+        return DWT->CYCCNT;
+#elif defined(__MBED__)
+        return us_ticker_read();
+#else
+        return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /** Get the counting rate in ticks per second
+     */
+    static uint32_t hz()
+    {
+#if defined(CYCLECOUNTER_HZ)
+        return CYCLECOUNTER_HZ;
+#elif defined(__MBED__) && defined(DWT_CTRL_CYCCNTENA_Msk)
+        return SystemCoreClock;
+#elif defined(__MBED__)
+        return 1000000;
+#else
+        return 1000000000;
+#endif
+    }
+};
+
+/** @}*/
+
+}
+
+#endif
@@ -0,0 +1,178 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_LATENCYHISTOGRAM_H
+#define MBED_LATENCYHISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include "platform/mbed_critical.h"
+#include "platform/mbed_assert.h"
+
+namespace mbed {
+
+/** \addtogroup platform-public-api */
+/** @{*/
+
+/** Fixed size histogram of 32 bit durations with a bounded relative error.
+ *
+ *  Values below 2^SubBucketBits get a bucket each, every higher power of two
+ *  range is split into 2^SubBucketBits equal buckets, so percentiles are off
+ *  by at most 1 / 2^SubBucketBits. The default of 3 takes 240 counters.
+ *
+ *  record() must only be called from one context at a time, readers may run
+ *  concurrently and see a value recorded in some counters but not yet in others.
+ *
+ *  @tparam SubBucketBits Precision, 1 to 8 bits
+ */
+template<unsigned SubBucketBits = 3>
+class LatencyHistogram {
+public:
+    /** Buckets per power of two */
+    static const unsigned sub_buckets = 1u << SubBucketBits;
+
+    /** Number of counters */
+    static const unsigned buckets = (33 - SubBucketBits) * sub_buckets;
+
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    /** Add one value
+     */
+    void record(uint32_t value)
+    {
+        _counts[index(value)]++;
+        _count++;
+        _total += value;
+        if (value > _max) {
+            _max = value;
+        }
+    }
+
+    /** Forget all values
+     */
+    void reset()
+    {
+        core_util_critical_section_enter();
+        memset((void *)_counts, 0, sizeof(_counts));
+        _count = 0;
+        _total = 0;
+        _max = 0;
+        core_util_critical_section_exit();
+    }
+
+    /** Get the number of values recorded
+     */
+    uint32_t count() const
+    {
+        return core_util_atomic_load_u32(&_count);
+    }
+
+    /** Get the largest value recorded
+     */
+    uint32_t max() const
+    {
+        return core_util_atomic_load_u32(&_max);
+    }
+
+    /** Get the sum of all values recorded
+     */
+    uint64_t total() const
+    {
+        core_util_critical_section_enter();
+        uint64_t total = _total;
+        core_util_critical_section_exit();
+        return total;
+    }
+
+    /** Get the value that the given share of all values doesn't exceed,
+     *  rounded up to the end of its bucket
+     *
+     *  @param per_million Share of values, 500000 for the median
+     *  @return The value, 0 when nothing was recorded
+     */
+    uint32_t percentile(uint32_t per_million) const
+    {
+        uint64_t count = 0;
+        for (unsigned i = 0; i < buckets; i++) {
+            count += _counts[i];
+        }
+        // rank of the value asked for, counted from 1
+        uint64_t rank = (count * per_million + 999999) / 1000000;
+        if (rank == 0) {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < buckets && count != 0; i++) {
+            seen += _counts[i];
+            if (seen >= rank) {
+                uint32_t value = upper(i);
+                uint32_t largest = max();
+                return value < largest ? value : largest;
+            }
+        }
+        return 0;
+    }
+
+private:
+    MBED_STRUCT_STATIC_ASSERT(SubBucketBits >= 1 && SubBucketBits <= 8, "LatencyHistogram precision must be 1 to 8 bits");
+
+    static unsigned log2(uint32_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 31 - __builtin_clz(value);
+#else
+        unsigned b = 0;
+        while (value >>= 1) {
+            b++;
+        }
+        return b;
+#endif
+    }
+
+    static unsigned index(uint32_t value)
+    {
+        if (value < sub_buckets) {
+            return value;
+        }
+        unsigned shift = log2(value) - SubBucketBits;
+        return (shift + 1) * sub_buckets + (value >> shift) - sub_buckets;
+    }
+
+    // largest value that falls into bucket i
+    static uint32_t upper(unsigned i)
+    {
+        if (i < sub_buckets) {
+            return i;
+        }
+        unsigned shift = i / sub_buckets - 1;
+        uint32_t lowest = (uint32_t)(i % sub_buckets + sub_buckets) << shift;
+        return lowest + (((uint32_t)1 << shift) - 1);
+    }
+
+    volatile uint32_t _counts[buckets];
+    volatile uint32_t _count;
+    volatile uint32_t _max;
+    uint64_t _total;
+};
+
+/** @}*/
+
+}
+
+#endif
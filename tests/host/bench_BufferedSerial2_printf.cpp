@@ -0,0 +1,82 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Formats the same lines into the tx buffer with the port's own printf() and
+// with Stream::printf(), which in the stubs formats with the host's vsnprintf
+// like the retargeted stdio does. The line is drained outside the timed part.
+// Usage: BufferedSerial2_printf_bench [thousands of lines]
+
+#include "BufferedSerial2.h"
+#include "FakeHal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+namespace {
+
+const size_t lines_per_batch = 256;
+
+typedef BufferedSerial2Static<16, 16384> Port;
+
+struct Fast {
+    static int print(Port &port, unsigned i)
+    {
+        return port.printf("t=%lu id=%04x v=%d/%u %s %.3f\r\n", 1000000UL + i, i & 0xffff, -(int)i, i * 7u, "ok", i * 0.001);
+    }
+};
+
+struct Stdio {
+    static int print(Port &port, unsigned i)
+    {
+        return port.Stream::printf("t=%lu id=%04x v=%d/%u %s %.3f\r\n", 1000000UL + i, i & 0xffff, -(int)i, i * 7u, "ok", i * 0.001);
+    }
+};
+
+template<typename Printer>
+double run(Port &port, size_t lines)
+{
+    std::chrono::steady_clock::duration spent(0);
+    size_t bytes = 0;
+
+    for (size_t done = 0; done < lines; done += lines_per_batch) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < lines_per_batch; i++) {
+            bytes += Printer::print(port, (unsigned)(done + i));
+        }
+        spent += std::chrono::steady_clock::now() - start;
+        FakeHal::transmit();
+        FakeHal::take_line();
+    }
+    return std::chrono::duration<double, std::nano>(spent).count() / lines;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    size_t lines = (argc > 1 ? strtoul(argv[1], NULL, 0) : 200) * 1000;
+
+    FakeHal::reset();
+    Port port(NC, NC);
+
+    printf("%zu lines of about 50 bytes, formatting time per line\n", lines);
+    for (int round = 0; round < 3; round++) {
+        printf("%-24s %8.1f ns\n", "BufferedSerial2::printf", run<Fast>(port, lines));
+        printf("%-24s %8.1f ns\n", "Stream::printf", run<Stdio>(port, lines));
+    }
+    return 0;
+}
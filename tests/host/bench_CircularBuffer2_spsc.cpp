@@ -0,0 +1,115 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Moves bytes one at a time from a producer to a consumer thread, pinned to
+// different cores where the host allows, through rings that differ only in
+// their index layout. Usage: CircularBuffer2_spsc_bench [megabytes] [producer cpu] [consumer cpu]
+
+#include "CircularBuffer2.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace mbed;
+
+namespace {
+
+const size_t ring_size = 256;
+// both threads share a core: don't spin away the other one's time slice
+bool single_core = false;
+
+void pin(int cpu)
+{
+#if defined(__linux__)
+    if (single_core) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "can't pin to cpu %d, running unpinned\n", cpu);
+    }
+#endif
+}
+
+template<typename Sync>
+void run(const char *name, size_t bytes, int producer_cpu, int consumer_cpu)
+{
+    static char pool[ring_size];
+    CircularBuffer2<char, Sync, CircularBuffer2PowerOfTwo> ring(pool, sizeof(pool));
+    unsigned checksum = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::thread consumer([&] {
+        pin(consumer_cpu);
+        for (size_t i = 0; i < bytes;) {
+            char c;
+            if (ring.pop(c)) {
+                checksum += (unsigned char)c;
+                i++;
+            } else if (single_core) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    std::thread producer([&] {
+        pin(producer_cpu);
+        for (size_t i = 0; i < bytes;) {
+            // what put() does: ask for room first, then push
+            if (ring.space(1) != 0 && ring.push((char)i)) {
+                i++;
+            } else if (single_core) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    producer.join();
+    consumer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    unsigned expected = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        expected += (unsigned char)(char)i;
+    }
+    printf("%-24s %8.1f MB/s%s\n", name, bytes / seconds / 1e6, checksum == expected ? "" : "  CORRUPTED");
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    size_t bytes = (argc > 1 ? strtoul(argv[1], NULL, 0) : 64) << 20;
+    int producer_cpu = argc > 2 ? atoi(argv[2]) : 0;
+    int consumer_cpu = argc > 3 ? atoi(argv[3]) : 1;
+
+    single_core = std::thread::hardware_concurrency() < 2;
+    if (single_core) {
+        printf("only one cpu, the results don't show cache line transfers\n");
+    }
+    printf("%zu MB through a %zu byte ring, cpu %d to cpu %d\n", bytes >> 20, ring_size, producer_cpu, consumer_cpu);
+    for (int round = 0; round < 3; round++) {
+        run<CircularBuffer2SPSC>("packed indices", bytes, producer_cpu, consumer_cpu);
+        run<CircularBuffer2SPSCCacheAligned<64> >("cache-aligned indices", bytes, producer_cpu, consumer_cpu);
+    }
+    return 0;
+}
@@ -0,0 +1,661 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeHal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "platform/mbed_assert.h"
+#include "platform/mbed_critical.h"
+#include "hal/us_ticker_api.h"
+#include "drivers/RawSerial.h"
+#include "drivers/Timeout.h"
+#include "platform/Stream.h"
+
+using namespace mbed;
+
+namespace {
+
+std::recursive_mutex critical;
+thread_local unsigned critical_depth = 0;
+thread_local unsigned isr_depth = 0;
+
+struct Uart {
+    SerialBase *port;
+    bool irq[2];
+    size_t tx_depth;
+    size_t rx_depth;
+    std::deque<char> tx_fifo;
+    std::deque<char> rx_fifo;
+    std::string line;
+    // asynchronous (DMA) transmission
+    bool tx_active;
+    event_callback_t tx_callback;
+    bool tx_busy_in_callback;
+    // asynchronous (DMA) reception
+    bool rx_active;
+    event_callback_t rx_callback;
+};
+
+Uart uart = {NULL, {false, false}, 1, 16};
+
+std::mutex unmask_mutex;
+std::atomic<unsigned> unmask_countdown(0);
+std::function<void()> unmask_action;
+
+std::thread line_thread;
+std::atomic<bool> line_running(false);
+
+Timeout *timeouts = NULL;
+
+uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+extern "C" void mbed_assert_internal(const char *expr, const char *file, int line)
+{
+    fprintf(stderr, "assertion failed: %s, file: %s, line %d\n", expr, file, line);
+    abort();
+}
+
+extern "C" void core_util_critical_section_enter(void)
+{
+    critical.lock();
+    critical_depth++;
+}
+
+extern "C" void core_util_critical_section_exit(void)
+{
+    MBED_ASSERT(critical_depth > 0);
+    bool outermost = --critical_depth == 0 && isr_depth == 0;
+    critical.unlock();
+    if (outermost) {
+        FakeHal::unmasked();
+    }
+}
+
+extern "C" bool core_util_is_isr_active(void)
+{
+    return isr_depth != 0;
+}
+
+extern "C" uint32_t us_ticker_read(void)
+{
+    return (uint32_t)now_us();
+}
+
+extern "C" int serial_readable(serial_t *obj)
+{
+    return !uart.rx_fifo.empty();
+}
+
+extern "C" int serial_writable(serial_t *obj)
+{
+    return uart.tx_fifo.size() < uart.tx_depth;
+}
+
+extern "C" int serial_getc(serial_t *obj)
+{
+    MBED_ASSERT(!uart.rx_fifo.empty());
+    char c = uart.rx_fifo.front();
+    uart.rx_fifo.pop_front();
+    return (unsigned char)c;
+}
+
+extern "C" void serial_putc(serial_t *obj, int c)
+{
+    if (uart.tx_fifo.size() == uart.tx_depth) {
+        // a real UART would busy wait until this byte left
+        uart.line.push_back(uart.tx_fifo.front());
+        uart.tx_fifo.pop_front();
+    }
+    uart.tx_fifo.push_back((char)c);
+}
+
+extern "C" void serial_irq_set(serial_t *obj, SerialIrq irq, uint32_t enable)
+{
+    uart.irq[irq] = enable != 0;
+}
+
+void FakeHal::take_irq(int irq)
+{
+    if (uart.port != NULL && uart.irq[irq] && uart.port->_irq[irq]) {
+        uart.port->_irq[irq]();
+    }
+}
+
+// the interrupts a real UART would raise right now
+void FakeHal::take_level_irqs()
+{
+    if (uart.irq[RxIrq] && !uart.rx_fifo.empty()) {
+        take_irq(RxIrq);
+    }
+    if (uart.irq[TxIrq] && uart.tx_fifo.size() < uart.tx_depth) {
+        take_irq(TxIrq);
+    }
+}
+
+void FakeHal::unmasked()
+{
+    interrupt(take_level_irqs);
+
+    unsigned count = unmask_countdown.load();
+    while (count != 0 && !unmask_countdown.compare_exchange_weak(count, count - 1)) {
+    }
+    if (count == 1) {
+        std::function<void()> action;
+        {
+            std::lock_guard<std::mutex> lock(unmask_mutex);
+            action.swap(unmask_action);
+        }
+        interrupt(action);
+    }
+}
+
+void FakeHal::reset(size_t tx_fifo_depth, size_t rx_fifo_depth)
+{
+    stop();
+    core_util_critical_section_enter();
+    uart.port = NULL;
+    uart.irq[RxIrq] = false;
+    uart.irq[TxIrq] = false;
+    uart.tx_depth = tx_fifo_depth;
+    uart.rx_depth = rx_fifo_depth;
+    uart.tx_fifo.clear();
+    uart.rx_fifo.clear();
+    uart.line.clear();
+    uart.tx_active = false;
+    uart.tx_callback = NULL;
+    uart.tx_busy_in_callback = false;
+    uart.rx_active = false;
+    uart.rx_callback = NULL;
+    timeouts = NULL;
+    unmask_countdown = 0;
+    core_util_critical_section_exit();
+}
+
+void FakeHal::interrupt(const std::function<void()> &func)
+{
+    std::lock_guard<std::recursive_mutex> lock(critical);
+    isr_depth++;
+    func();
+    isr_depth--;
+}
+
+size_t FakeHal::transmit(size_t max)
+{
+    size_t sent = 0;
+
+    interrupt([&] {
+        while (sent < max) {
+            if (uart.tx_fifo.empty()) {
+                take_irq(TxIrq);
+                if (uart.tx_fifo.empty()) {
+                    break;
+                }
+            }
+            uart.line.push_back(uart.tx_fifo.front());
+            uart.tx_fifo.pop_front();
+            sent++;
+            take_irq(TxIrq);
+        }
+    });
+    return sent;
+}
+
+size_t FakeHal::receive(const void *data, size_t length)
+{
+    const char *bytes = (const char *)data;
+    size_t received = 0;
+
+    interrupt([&] {
+        for (size_t i = 0; i < length; i++) {
+            if (uart.port != NULL && uart.rx_active) {
+                // the DMA moves the byte to memory, the callback only comes once the
+                // transfer is full or the byte to match arrived
+                serial_t &serial = uart.port->_serial;
+                buffer_s &transfer = serial.rx_buff;
+                ((char *)transfer.buffer)[transfer.pos++] = bytes[i];
+                received++;
+                int event = transfer.pos == transfer.length ? SERIAL_EVENT_RX_COMPLETE : 0;
+                if (serial.char_match != SERIAL_RESERVED_CHAR_MATCH && (unsigned char)bytes[i] == serial.char_match) {
+                    event |= SERIAL_EVENT_RX_CHARACTER_MATCH;
+                }
+                if (event != 0) {
+                    uart.rx_active = false;
+                    event_callback_t callback = uart.rx_callback;
+                    uart.rx_callback = NULL;
+                    if (callback) {
+                        callback(event);
+                    }
+                }
+                continue;
+            }
+            if (uart.rx_fifo.size() < uart.rx_depth) {
+                uart.rx_fifo.push_back(bytes[i]);
+                received++;
+            }
+            if (uart.rx_fifo.size() == uart.rx_depth || i + 1 == length) {
+                take_irq(RxIrq);
+            }
+        }
+    });
+    return received;
+}
+
+std::string FakeHal::take_line()
+{
+    std::string line;
+
+    core_util_critical_section_enter();
+    line.swap(uart.line);
+    core_util_critical_section_exit();
+    return line;
+}
+
+std::string FakeHal::pattern(size_t length, unsigned seed)
+{
+    std::string data;
+    for (size_t i = 0; i < length; i++) {
+        data.push_back((char)('a' + (i * 7 + seed) % 26));
+    }
+    return data;
+}
+
+size_t FakeHal::tx_fifo_level()
+{
+    core_util_critical_section_enter();
+    size_t level = uart.tx_fifo.size();
+    core_util_critical_section_exit();
+    return level;
+}
+
+bool FakeHal::tx_irq_enabled()
+{
+    core_util_critical_section_enter();
+    bool enabled = uart.irq[TxIrq];
+    core_util_critical_section_exit();
+    return enabled;
+}
+
+bool FakeHal::complete_tx()
+{
+    bool completed = false;
+
+    interrupt([&] {
+        if (uart.port == NULL || !uart.tx_active) {
+            return;
+        }
+        buffer_s &transfer = uart.port->_serial.tx_buff;
+        uart.line.append((const char *)transfer.buffer, transfer.length);
+        transfer.pos = transfer.length;
+        // some HALs only end the transfer after its callback returns
+        bool busy = uart.tx_busy_in_callback;
+        uart.tx_active = busy;
+        event_callback_t callback = uart.tx_callback;
+        uart.tx_callback = NULL;
+        if (callback) {
+            callback(SERIAL_EVENT_TX_COMPLETE);
+        }
+        if (busy) {
+            uart.tx_active = false;
+        }
+        completed = true;
+    });
+    return completed;
+}
+
+bool FakeHal::tx_dma_active()
+{
+    core_util_critical_section_enter();
+    bool active = uart.tx_active;
+    core_util_critical_section_exit();
+    return active;
+}
+
+void FakeHal::tx_busy_in_callback(bool busy)
+{
+    core_util_critical_section_enter();
+    uart.tx_busy_in_callback = busy;
+    core_util_critical_section_exit();
+}
+
+void FakeHal::at_unmask(unsigned count, const std::function<void()> &action)
+{
+    std::lock_guard<std::mutex> lock(unmask_mutex);
+    unmask_action = action;
+    unmask_countdown = count;
+}
+
+bool FakeHal::unmask_pending()
+{
+    return unmask_countdown != 0;
+}
+
+void FakeHal::start(uint32_t byte_us)
+{
+    stop();
+    line_running = true;
+    line_thread = std::thread([byte_us] {
+        while (line_running) {
+            if (byte_us != 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(byte_us));
+            } else {
+                std::this_thread::yield();
+            }
+            transmit(1);
+            complete_tx();
+            fire_timeouts();
+        }
+    });
+}
+
+size_t FakeHal::timeouts_armed()
+{
+    size_t armed = 0;
+
+    core_util_critical_section_enter();
+    for (Timeout *t = timeouts; t != NULL; t = t->_next) {
+        armed += t->_armed;
+    }
+    core_util_critical_section_exit();
+    return armed;
+}
+
+void FakeHal::stop()
+{
+    line_running = false;
+    if (line_thread.joinable()) {
+        line_thread.join();
+    }
+}
+
+void FakeHal::fire_timeouts(bool all)
+{
+    std::vector<Timeout *> due;
+    uint64_t now = now_us();
+
+    core_util_critical_section_enter();
+    for (Timeout *t = timeouts; t != NULL; t = t->_next) {
+        if (t->_armed && (all || t->_deadline <= now)) {
+            due.push_back(t);
+        }
+    }
+    core_util_critical_section_exit();
+
+    // a handler may detach or re-attach any of them, only take those still due
+    for (size_t i = 0; i < due.size(); i++) {
+        interrupt([&] {
+            Timeout *t = due[i];
+            if (t->_armed && (all || t->_deadline <= now)) {
+                t->_armed = false;
+                t->_function();
+            }
+        });
+    }
+}
+
+SerialBase::SerialBase(PinName tx, PinName rx, int baud)
+{
+    memset(&_serial, 0, sizeof(_serial));
+    core_util_critical_section_enter();
+    MBED_ASSERT(uart.port == NULL);
+    uart.port = this;
+    core_util_critical_section_exit();
+}
+
+SerialBase::~SerialBase()
+{
+    core_util_critical_section_enter();
+    if (uart.port == this) {
+        uart.port = NULL;
+        uart.irq[RxIrq] = false;
+        uart.irq[TxIrq] = false;
+    }
+    core_util_critical_section_exit();
+}
+
+int SerialBase::readable()
+{
+    core_util_critical_section_enter();
+    int readable = serial_readable(&_serial);
+    core_util_critical_section_exit();
+    return readable;
+}
+
+int SerialBase::writeable()
+{
+    core_util_critical_section_enter();
+    int writable = serial_writable(&_serial);
+    core_util_critical_section_exit();
+    return writable;
+}
+
+void SerialBase::attach(Callback<void()> func, IrqType type)
+{
+    core_util_critical_section_enter();
+    _irq[type] = func;
+    serial_irq_set(&_serial, (SerialIrq)type, func ? 1 : 0);
+    core_util_critical_section_exit();
+}
+
+int SerialBase::write(const uint8_t *buffer, int length, const event_callback_t &callback, int event)
+{
+    int result = -1;
+
+    core_util_critical_section_enter();
+    if (!uart.tx_active) {
+        _serial.tx_buff.buffer = (void *)buffer;
+        _serial.tx_buff.length = length;
+        _serial.tx_buff.pos = 0;
+        _serial.tx_buff.width = 8;
+        uart.tx_active = true;
+        uart.tx_callback = callback;
+        result = 0;
+    }
+    core_util_critical_section_exit();
+    return result;
+}
+
+void SerialBase::abort_write()
+{
+    core_util_critical_section_enter();
+    uart.tx_active = false;
+    uart.tx_callback = NULL;
+    core_util_critical_section_exit();
+}
+
+int SerialBase::read(uint8_t *buffer, int length, const event_callback_t &callback, int event, unsigned char char_match)
+{
+    int result = -1;
+
+    core_util_critical_section_enter();
+    if (!uart.rx_active) {
+        _serial.rx_buff.buffer = buffer;
+        _serial.rx_buff.length = length;
+        _serial.rx_buff.pos = 0;
+        _serial.rx_buff.width = 8;
+        _serial.char_match = char_match;
+        uart.rx_active = true;
+        uart.rx_callback = callback;
+        result = 0;
+    }
+    core_util_critical_section_exit();
+    return result;
+}
+
+void SerialBase::abort_read()
+{
+    core_util_critical_section_enter();
+    uart.rx_active = false;
+    uart.rx_callback = NULL;
+    core_util_critical_section_exit();
+}
+
+int SerialBase::set_dma_usage_tx(DMAUsage usage)
+{
+    return 0;
+}
+
+int SerialBase::set_dma_usage_rx(DMAUsage usage)
+{
+    return 0;
+}
+
+int SerialBase::_base_getc()
+{
+    core_util_critical_section_enter();
+    int c = serial_readable(&_serial) ? serial_getc(&_serial) : -1;
+    core_util_critical_section_exit();
+    return c;
+}
+
+int SerialBase::_base_putc(int c)
+{
+    core_util_critical_section_enter();
+    serial_putc(&_serial, c);
+    core_util_critical_section_exit();
+    return c;
+}
+
+int RawSerial::puts(const char *str)
+{
+    const char *s = str;
+    while (*s != '\0') {
+        _base_putc(*s++);
+    }
+    return s - str;
+}
+
+int RawSerial::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = RawSerial::vprintf(format, args);
+    va_end(args);
+    return length;
+}
+
+int RawSerial::vprintf(const char *format, va_list arg)
+{
+    char buffer[256];
+    int length = vsnprintf(buffer, sizeof(buffer), format, arg);
+    for (int i = 0; i < length && i < (int)sizeof(buffer) - 1; i++) {
+        _base_putc(buffer[i]);
+    }
+    return length;
+}
+
+Timeout::Timeout() : _deadline(0), _armed(false), _next(NULL)
+{
+}
+
+Timeout::~Timeout()
+{
+    detach();
+}
+
+void Timeout::attach_us(Callback<void()> func, uint64_t t)
+{
+    core_util_critical_section_enter();
+    detach();
+    _function = func;
+    _deadline = now_us() + t;
+    _armed = true;
+    _next = timeouts;
+    timeouts = this;
+    core_util_critical_section_exit();
+}
+
+void Timeout::detach()
+{
+    core_util_critical_section_enter();
+    _armed = false;
+    for (Timeout **t = &timeouts; *t != NULL; t = &(*t)->_next) {
+        if (*t == this) {
+            *t = _next;
+            break;
+        }
+    }
+    _next = NULL;
+    core_util_critical_section_exit();
+}
+
+int Stream::puts(const char *s)
+{
+    return write(s, strlen(s));
+}
+
+int Stream::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int length = Stream::vprintf(format, args);
+    va_end(args);
+    return length;
+}
+
+int Stream::vprintf(const char *format, va_list args)
+{
+    // what the retargeted stdio does: format into the FILE buffer, then write() it
+    char buffer[BUFSIZ];
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    if (length >= (int)sizeof(buffer)) {
+        std::vector<char> large(length + 1);
+        vsnprintf(&large[0], large.size(), format, copy);
+        write(&large[0], length);
+    } else if (length > 0) {
+        write(buffer, length);
+    }
+    va_end(copy);
+    return length;
+}
+
+ssize_t Stream::read(void *buffer, size_t length)
+{
+    char *ptr = (char *)buffer;
+    for (size_t i = 0; i < length; i++) {
+        int c = _getc();
+        if (c < 0) {
+            return i;
+        }
+        ptr[i] = (char)c;
+    }
+    return length;
+}
+
+ssize_t Stream::write(const void *buffer, size_t length)
+{
+    const char *ptr = (const char *)buffer;
+    for (size_t i = 0; i < length; i++) {
+        if (_putc(ptr[i]) < 0) {
+            return i;
+        }
+    }
+    return length;
+}
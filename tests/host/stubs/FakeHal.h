@@ -0,0 +1,132 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_FAKEHAL_H
+#define MBED_FAKEHAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+/** Simulated hardware behind the host stubs: one UART with tx and rx FIFOs,
+ *  interrupts and timeouts.
+ *
+ *  Interrupt handlers run on the thread that triggers them, holding the lock
+ *  that core_util_critical_section_enter() takes, so they never overlap a
+ *  critical section or each other. Like level triggered interrupts, enabled
+ *  UART interrupts whose condition holds are also taken whenever a thread
+ *  leaves its outermost critical section.
+ */
+class FakeHal {
+public:
+    /** Detach the UART from its port and empty it
+     *  @param tx_fifo_depth Bytes the tx FIFO holds
+     *  @param rx_fifo_depth Bytes the rx FIFO holds before it overruns
+     */
+    static void reset(size_t tx_fifo_depth = 1, size_t rx_fifo_depth = 16);
+
+    /** Run a function as an interrupt handler on the calling thread
+     */
+    static void interrupt(const std::function<void()> &func);
+
+    /** Shift bytes from the tx FIFO onto the line, taking the tx interrupt
+     *  after every byte while it is enabled
+     *  @param max Most bytes to shift
+     *  @return Bytes shifted
+     */
+    static size_t transmit(size_t max = SIZE_MAX);
+
+    /** Receive bytes, taking the rx interrupt whenever the rx FIFO fills up
+     *  and after the last byte. Bytes that find the FIFO full are lost.
+     *  During an asynchronous (DMA) reception bytes go straight to its buffer,
+     *  advancing rx_buff.pos, and its callback is called once it is full or
+     *  its character to match arrived
+     *  @return Bytes that made it into the FIFO or the buffer
+     */
+    static size_t receive(const void *data, size_t length);
+
+    /** Take the bytes shifted onto the line so far
+     */
+    static std::string take_line();
+
+    /** Make length bytes of test data, lowercase letters in an order that
+     *  depends on the seed
+     */
+    static std::string pattern(size_t length, unsigned seed = 0);
+
+    /** Get the number of bytes waiting in the tx FIFO
+     */
+    static size_t tx_fifo_level();
+
+    /** Check if the tx interrupt is enabled
+     */
+    static bool tx_irq_enabled();
+
+    /** Finish the asynchronous (DMA) transmission in progress: put the whole
+     *  transfer on the line and call its callback as an interrupt
+     *  @return True if a transfer was in progress
+     */
+    static bool complete_tx();
+
+    /** Check if an asynchronous transmission is in progress
+     */
+    static bool tx_dma_active();
+
+    /** Keep reporting a finished transmission as in progress until its
+     *  callback returns, as some HALs do, so the callback can't start the next
+     */
+    static void tx_busy_in_callback(bool busy);
+
+    /** Run an action as an interrupt when the calling or another thread
+     *  leaves its outermost critical section for the count-th time from now,
+     *  to place an interrupt at an exact point of the code under test
+     */
+    static void at_unmask(unsigned count, const std::function<void()> &action);
+
+    /** Check if an action given to at_unmask() is still waiting
+     */
+    static bool unmask_pending();
+
+    /** Run the line in a background thread: shift out one byte every
+     *  byte_us microseconds (0 for as fast as possible), finish asynchronous
+     *  transmissions and take due timeouts
+     */
+    static void start(uint32_t byte_us);
+
+    /** Stop the background thread
+     */
+    static void stop();
+
+    /** Take the timeouts that are due, or all attached ones
+     */
+    static void fire_timeouts(bool all = false);
+
+    /** Get the number of attached timeouts that haven't fired yet
+     */
+    static size_t timeouts_armed();
+
+    /** Take the UART interrupts whose condition holds and a due at_unmask()
+     *  action, called as a thread leaves its outermost critical section
+     */
+    static void unmasked();
+
+private:
+    static void take_irq(int irq);
+    static void take_level_irqs();
+};
+
+#endif
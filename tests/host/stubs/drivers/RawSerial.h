@@ -0,0 +1,48 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_RAWSERIAL_H
+#define MBED_RAWSERIAL_H
+
+#include <stdarg.h>
+#include "drivers/SerialBase.h"
+
+namespace mbed {
+
+class RawSerial : public SerialBase {
+public:
+    RawSerial(PinName tx, PinName rx, int baud = MBED_CONF_PLATFORM_DEFAULT_SERIAL_BAUD_RATE) : SerialBase(tx, rx, baud)
+    {
+    }
+
+    int putc(int c)
+    {
+        return _base_putc(c);
+    }
+
+    int getc()
+    {
+        return _base_getc();
+    }
+
+    int puts(const char *str);
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    int vprintf(const char *format, va_list arg);
+};
+
+}
+
+#endif
@@ -0,0 +1,45 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_SERIAL_H
+#define MBED_SERIAL_H
+
+#include "drivers/SerialBase.h"
+#include "platform/Stream.h"
+
+namespace mbed {
+
+class Serial : public SerialBase, public Stream {
+public:
+    Serial(PinName tx, PinName rx, int baud = MBED_CONF_PLATFORM_DEFAULT_SERIAL_BAUD_RATE) : SerialBase(tx, rx, baud)
+    {
+    }
+
+protected:
+    virtual int _getc()
+    {
+        return _base_getc();
+    }
+
+    virtual int _putc(int c)
+    {
+        return _base_putc(c);
+    }
+};
+
+}
+
+#endif
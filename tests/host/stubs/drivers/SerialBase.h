@@ -0,0 +1,77 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_SERIALBASE_H
+#define MBED_SERIALBASE_H
+
+#include "hal/serial_api.h"
+#include "platform/Callback.h"
+#include "platform/NonCopyable.h"
+
+#ifndef MBED_CONF_PLATFORM_DEFAULT_SERIAL_BAUD_RATE
+#define MBED_CONF_PLATFORM_DEFAULT_SERIAL_BAUD_RATE 9600
+#endif
+
+class FakeHal;
+
+namespace mbed {
+
+typedef Callback<void(int)> event_callback_t;
+
+/** Host version of mbed::SerialBase, backed by the single fake UART of FakeHal
+ */
+class SerialBase : private NonCopyable<SerialBase> {
+public:
+    enum IrqType {
+        RxIrq = 0,
+        TxIrq,
+
+        IrqCnt
+    };
+
+    void baud(int baudrate)
+    {
+    }
+
+    int readable();
+    int writeable();
+
+    void attach(Callback<void()> func, IrqType type = RxIrq);
+
+    int write(const uint8_t *buffer, int length, const event_callback_t &callback, int event = SERIAL_EVENT_TX_COMPLETE);
+    void abort_write();
+    int read(uint8_t *buffer, int length, const event_callback_t &callback, int event = SERIAL_EVENT_RX_COMPLETE,
+             unsigned char char_match = SERIAL_RESERVED_CHAR_MATCH);
+    void abort_read();
+    int set_dma_usage_tx(DMAUsage usage);
+    int set_dma_usage_rx(DMAUsage usage);
+
+protected:
+    SerialBase(PinName tx, PinName rx, int baud);
+    virtual ~SerialBase();
+
+    int _base_getc();
+    int _base_putc(int c);
+
+    friend class ::FakeHal;
+
+    serial_t _serial;
+    Callback<void()> _irq[IrqCnt];
+};
+
+}
+
+#endif
@@ -0,0 +1,56 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_TIMEOUT_H
+#define MBED_TIMEOUT_H
+
+#include <stdint.h>
+#include "platform/Callback.h"
+#include "platform/NonCopyable.h"
+
+class FakeHal;
+
+namespace mbed {
+
+/** Host version of mbed::Timeout. FakeHal runs the callback as an interrupt
+ *  once the host clock passes the deadline, or when a test advances it
+ */
+class Timeout : private NonCopyable<Timeout> {
+public:
+    Timeout();
+    ~Timeout();
+
+    void attach_us(Callback<void()> func, uint64_t t);
+
+    void attach(Callback<void()> func, float t)
+    {
+        attach_us(func, (uint64_t)(t * 1000000.0f));
+    }
+
+    void detach();
+
+private:
+    friend class ::FakeHal;
+
+    Callback<void()> _function;
+    uint64_t _deadline;
+    bool _armed;
+    Timeout *_next;
+};
+
+}
+
+#endif
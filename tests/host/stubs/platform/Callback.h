@@ -0,0 +1,95 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_CALLBACK_H
+#define MBED_CALLBACK_H
+
+#include <functional>
+
+namespace mbed {
+
+template<typename F>
+class Callback;
+
+/** Host version of mbed::Callback on std::function, for functions and
+ *  member functions
+ */
+template<typename R, typename... ArgTs>
+class Callback<R(ArgTs...)> {
+public:
+    Callback(R(*func)(ArgTs...) = 0)
+    {
+        if (func) {
+            _func = func;
+        }
+    }
+
+    template<typename T, typename U>
+    Callback(U *obj, R(T::*method)(ArgTs...))
+        : _func([obj, method](ArgTs... args) {
+        return (obj->*method)(args...);
+    })
+    {
+    }
+
+    template<typename T, typename U>
+    Callback(const U *obj, R(T::*method)(ArgTs...) const)
+        : _func([obj, method](ArgTs... args) {
+        return (obj->*method)(args...);
+    })
+    {
+    }
+
+    R call(ArgTs... args) const
+    {
+        return _func(args...);
+    }
+
+    R operator()(ArgTs... args) const
+    {
+        return _func(args...);
+    }
+
+    operator bool() const
+    {
+        return static_cast<bool>(_func);
+    }
+
+private:
+    std::function<R(ArgTs...)> _func;
+};
+
+template<typename T, typename U, typename R, typename... ArgTs>
+Callback<R(ArgTs...)> callback(U *obj, R(T::*method)(ArgTs...))
+{
+    return Callback<R(ArgTs...)>(obj, method);
+}
+
+template<typename T, typename U, typename R, typename... ArgTs>
+Callback<R(ArgTs...)> callback(const U *obj, R(T::*method)(ArgTs...) const)
+{
+    return Callback<R(ArgTs...)>(obj, method);
+}
+
+template<typename R, typename... ArgTs>
+Callback<R(ArgTs...)> callback(R(*func)(ArgTs...) = 0)
+{
+    return Callback<R(ArgTs...)>(func);
+}
+
+}
+
+#endif
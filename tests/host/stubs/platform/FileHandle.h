@@ -0,0 +1,67 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_FILEHANDLE_H
+#define MBED_FILEHANDLE_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "platform/Callback.h"
+#include "platform/NonCopyable.h"
+
+#define POLLIN 0x0001
+#define POLLOUT 0x0010
+
+namespace mbed {
+
+class FileHandle : private NonCopyable<FileHandle> {
+public:
+    virtual ~FileHandle()
+    {
+    }
+
+    virtual ssize_t read(void *buffer, size_t size) = 0;
+    virtual ssize_t write(const void *buffer, size_t size) = 0;
+
+    virtual int sync()
+    {
+        return 0;
+    }
+
+    virtual int set_blocking(bool blocking)
+    {
+        return blocking ? 0 : -ENOTTY;
+    }
+
+    virtual bool is_blocking() const
+    {
+        return true;
+    }
+
+    virtual short poll(short events) const
+    {
+        return POLLIN | POLLOUT;
+    }
+
+    virtual void sigio(Callback<void()> func)
+    {
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_STREAM_H
+#define MBED_STREAM_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "platform/FileHandle.h"
+
+namespace mbed {
+
+/** Host version of mbed::Stream. printf() formats with the C library into a
+ *  local buffer and hands it to write(), as the retargeted stdio does on target
+ */
+class Stream : public FileHandle {
+public:
+    Stream(const char *name = 0)
+    {
+    }
+
+    virtual ~Stream()
+    {
+    }
+
+    int putc(int c)
+    {
+        return _putc(c);
+    }
+
+    int getc()
+    {
+        return _getc();
+    }
+
+    int puts(const char *s);
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    int vprintf(const char *format, va_list args);
+
+    virtual ssize_t read(void *buffer, size_t length);
+    virtual ssize_t write(const void *buffer, size_t length);
+
+protected:
+    virtual int _putc(int c) = 0;
+    virtual int _getc() = 0;
+};
+
+}
+
+#endif
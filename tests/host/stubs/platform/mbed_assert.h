@@ -0,0 +1,41 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_ASSERT_H
+#define MBED_ASSERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Report a failed assertion and abort, like mbed_error() does on target */
+void mbed_assert_internal(const char *expr, const char *file, int line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define MBED_ASSERT(expr) \
+    do { \
+        if (!(expr)) { \
+            mbed_assert_internal(#expr, __FILE__, __LINE__); \
+        } \
+    } while (0)
+
+#define MBED_STATIC_ASSERT(expr, msg) static_assert(expr, msg)
+#define MBED_STRUCT_STATIC_ASSERT(expr, msg) static_assert(expr, msg)
+
+#endif
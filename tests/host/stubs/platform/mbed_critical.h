@@ -0,0 +1,72 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_CRITICAL_H
+#define MBED_CRITICAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Critical sections exclude the simulated interrupts of FakeHal, and nest */
+void core_util_critical_section_enter(void);
+void core_util_critical_section_exit(void);
+
+/** True while FakeHal runs an interrupt handler on the calling thread */
+bool core_util_is_isr_active(void);
+
+#define MBED_HOST_ATOMIC_LOAD_STORE(T, name) \
+    static inline T core_util_atomic_load_##name(const volatile T *valuePtr) \
+    { \
+        return __atomic_load_n(valuePtr, __ATOMIC_SEQ_CST); \
+    } \
+    static inline void core_util_atomic_store_##name(volatile T *valuePtr, T desiredValue) \
+    { \
+        __atomic_store_n(valuePtr, desiredValue, __ATOMIC_SEQ_CST); \
+    } \
+    static inline bool core_util_atomic_cas_##name(volatile T *ptr, T *expectedCurrentValue, T desiredValue) \
+    { \
+        return __atomic_compare_exchange_n(ptr, expectedCurrentValue, desiredValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); \
+    }
+
+#define MBED_HOST_ATOMIC(T, name) \
+    MBED_HOST_ATOMIC_LOAD_STORE(T, name) \
+    static inline T core_util_atomic_incr_##name(volatile T *valuePtr, T delta) \
+    { \
+        return __atomic_add_fetch(valuePtr, delta, __ATOMIC_SEQ_CST); \
+    } \
+    static inline T core_util_atomic_decr_##name(volatile T *valuePtr, T delta) \
+    { \
+        return __atomic_sub_fetch(valuePtr, delta, __ATOMIC_SEQ_CST); \
+    }
+
+MBED_HOST_ATOMIC(uint8_t, u8)
+MBED_HOST_ATOMIC(uint16_t, u16)
+MBED_HOST_ATOMIC(uint32_t, u32)
+MBED_HOST_ATOMIC_LOAD_STORE(bool, bool)
+
+#undef MBED_HOST_ATOMIC
+#undef MBED_HOST_ATOMIC_LOAD_STORE
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
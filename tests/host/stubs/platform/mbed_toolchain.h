@@ -0,0 +1,26 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_TOOLCHAIN_H
+#define MBED_TOOLCHAIN_H
+
+#define MBED_ALIGN(N) __attribute__((aligned(N)))
+#define MBED_SECTION(name) __attribute__((section(name)))
+#define MBED_FORCEINLINE static inline __attribute__((always_inline))
+#define MBED_PRINTF_METHOD(format_index, first_param_index) \
+    __attribute__((format(printf, format_index + 1, first_param_index == 0 ? 0 : first_param_index + 1)))
+
+#endif
@@ -0,0 +1,121 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef EVENT_FLAG_H
+#define EVENT_FLAG_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "platform/NonCopyable.h"
+#include "platform/mbed_critical.h"
+#include "FakeHal.h"
+
+#define osWaitForever 0xFFFFFFFFU
+#define osFlagsError 0x80000000U
+#define osFlagsErrorTimeout 0xFFFFFFFEU
+
+namespace rtos {
+
+/** Host shim of rtos::EventFlags on a condition variable, with the
+ *  CMSIS-RTOS2 semantics the library relies on: set() may come from an
+ *  interrupt, wait_any() returns the flags before clearing them or
+ *  osFlagsErrorTimeout. A thread entering clear() or a wait takes pending
+ *  FakeHal interrupts first, as it would on its way into the kernel
+ */
+class EventFlags : private mbed::NonCopyable<EventFlags> {
+public:
+    EventFlags(uint32_t flags = 0) : _flags(flags)
+    {
+    }
+
+    uint32_t set(uint32_t flags)
+    {
+        set_calls()++;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _flags |= flags;
+        _changed.notify_all();
+        return _flags;
+    }
+
+    uint32_t clear(uint32_t flags = 0x7fffffff)
+    {
+        preempt();
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint32_t previous = _flags;
+        _flags &= ~flags;
+        return previous;
+    }
+
+    uint32_t get() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _flags;
+    }
+
+    uint32_t wait_any(uint32_t flags = 0, uint32_t millisec = osWaitForever, bool clear = true)
+    {
+        return wait(flags, millisec, clear, false);
+    }
+
+    uint32_t wait_all(uint32_t flags = 0, uint32_t millisec = osWaitForever, bool clear = true)
+    {
+        return wait(flags, millisec, clear, true);
+    }
+
+    /** Host only: set() calls on all instances, each is a kernel call on target
+     */
+    static std::atomic<uint32_t> &set_calls()
+    {
+        static std::atomic<uint32_t> calls(0);
+        return calls;
+    }
+
+private:
+    static void preempt()
+    {
+        if (!core_util_is_isr_active()) {
+            FakeHal::unmasked();
+        }
+    }
+
+    uint32_t wait(uint32_t flags, uint32_t millisec, bool clear, bool all)
+    {
+        preempt();
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto ready = [&] { return all ? (_flags & flags) == flags : (_flags & flags) != 0; };
+        if (millisec == osWaitForever) {
+            _changed.wait(lock, ready);
+        } else if (!_changed.wait_for(lock, std::chrono::milliseconds(millisec), ready)) {
+            return osFlagsErrorTimeout;
+        }
+        uint32_t previous = _flags;
+        if (clear) {
+            _flags &= ~flags;
+        }
+        return previous;
+    }
+
+    mutable std::mutex _mutex;
+    std::condition_variable _changed;
+    uint32_t _flags;
+};
+
+}
+
+#endif
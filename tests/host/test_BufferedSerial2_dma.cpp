@@ -0,0 +1,218 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "BufferedSerial2.h"
+#include "FakeHal.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+class TestBufferedSerial2TxDma : public testing::Test {
+protected:
+    TestBufferedSerial2TxDma()
+    {
+        FakeHal::reset();
+    }
+
+    ~TestBufferedSerial2TxDma()
+    {
+        FakeHal::stop();
+    }
+
+    char rx_buf[64];
+    char tx_buf[32];
+};
+
+TEST_F(TestBufferedSerial2TxDma, sends_contiguous_regions_of_the_buffer)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(40);
+
+    EXPECT_EQ(20, port.write(data.data(), 20));
+    EXPECT_TRUE(FakeHal::tx_dma_active());
+    EXPECT_TRUE(FakeHal::complete_tx());
+    EXPECT_EQ(data.substr(0, 20), FakeHal::take_line());
+
+    // wraps around the end of the buffer, one transfer per side
+    EXPECT_EQ(20, port.write(&data[20], 20));
+    EXPECT_TRUE(FakeHal::complete_tx());
+    EXPECT_EQ(data.substr(20, sizeof(tx_buf) - 20), FakeHal::take_line());
+    EXPECT_TRUE(FakeHal::complete_tx());
+    EXPECT_FALSE(FakeHal::complete_tx());
+    EXPECT_EQ(data.substr(sizeof(tx_buf)), FakeHal::take_line());
+    EXPECT_EQ(0, port.sync());
+}
+
+TEST_F(TestBufferedSerial2TxDma, overflow_leaves_the_bytes_in_flight_alone)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), 9600, false);
+    std::string first = FakeHal::pattern(16, 1);
+    std::string second = FakeHal::pattern(64, 2);
+
+    EXPECT_EQ(16, port.write(first.data(), first.size()));
+    EXPECT_TRUE(FakeHal::tx_dma_active());
+    // the buffer fills up while the first bytes are in flight, the rest is dropped
+    EXPECT_EQ(64, port.write(second.data(), second.size()));
+    EXPECT_EQ(48u, port.tx_dropped());
+    while (FakeHal::complete_tx()) {
+    }
+    EXPECT_EQ(first + second.substr(0, 16), FakeHal::take_line());
+}
+
+TEST_F(TestBufferedSerial2TxDma, overwriting_the_oldest_bytes_is_refused)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), 9600, false);
+
+    port.set_tx_overflow(mbed::CircularBuffer2Reject);
+    port.set_tx_overflow(mbed::CircularBuffer2DropNewest);
+    EXPECT_DEATH(port.set_tx_overflow(mbed::CircularBuffer2OverwriteOldest), "assertion failed");
+}
+
+TEST_F(TestBufferedSerial2TxDma, restart_refused_by_the_hal_is_retried)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(8 + sizeof(tx_buf));
+
+    port.set_tx_timeout(1000);
+    EXPECT_EQ(8, port.write(data.data(), 8));
+    EXPECT_TRUE(FakeHal::complete_tx());
+
+    // the completion of the first transfer can't start the one for the wrapped
+    // part, and sync() sleeps until the buffer is empty
+    FakeHal::tx_busy_in_callback(true);
+    EXPECT_EQ((ssize_t)sizeof(tx_buf), port.write(&data[8], sizeof(tx_buf)));
+    FakeHal::start(0);
+    EXPECT_EQ(0, port.sync());
+    FakeHal::stop();
+    EXPECT_EQ(data, FakeHal::take_line());
+}
+
+class TestBufferedSerial2RxDma : public testing::Test {
+public:
+    void signal()
+    {
+        signals++;
+    }
+
+protected:
+    TestBufferedSerial2RxDma() : signals(0)
+    {
+        FakeHal::reset();
+    }
+
+    ~TestBufferedSerial2RxDma()
+    {
+        FakeHal::stop();
+    }
+
+    char rx_buf[64];
+    char tx_buf[32];
+    unsigned signals;
+};
+
+TEST_F(TestBufferedSerial2RxDma, transfers_that_fill_up_are_published_on_completion)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(sizeof(rx_buf));
+    char buffer[sizeof(rx_buf)];
+
+    port.sigio(mbed::callback(this, &TestBufferedSerial2RxDma::signal));
+    port.set_rx_notify(sizeof(rx_buf));
+    EXPECT_EQ(data.size(), FakeHal::receive(data.data(), data.size()));
+    EXPECT_EQ(1u, signals);
+    EXPECT_EQ((ssize_t)data.size(), port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(data, std::string(buffer, data.size()));
+}
+
+TEST_F(TestBufferedSerial2RxDma, short_frame_with_nothing_after_it_is_published_by_the_poll)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    char buffer[sizeof(rx_buf)];
+
+    port.sigio(mbed::callback(this, &TestBufferedSerial2RxDma::signal));
+    port.set_rx_notify(5);
+    // waiting for a frame takes no periodic interrupt
+    EXPECT_EQ(0u, FakeHal::timeouts_armed());
+
+    // the first byte ends the single byte transfer, the rest goes to the next one
+    EXPECT_EQ(5u, FakeHal::receive("hello", 5));
+    EXPECT_EQ(0u, signals);
+    EXPECT_EQ(1u, FakeHal::timeouts_armed());
+    FakeHal::fire_timeouts(true);
+    EXPECT_EQ(1u, signals);
+    // a period without a byte ends the frame and the poll
+    FakeHal::fire_timeouts(true);
+    EXPECT_EQ(0u, FakeHal::timeouts_armed());
+    EXPECT_EQ(5, port.read(buffer, sizeof(buffer)));
+
+    EXPECT_EQ(5u, FakeHal::receive("world", 5));
+    FakeHal::fire_timeouts(true);
+    FakeHal::fire_timeouts(true);
+    EXPECT_EQ(2u, signals);
+    EXPECT_EQ(0u, FakeHal::timeouts_armed());
+    EXPECT_EQ(5, port.read(buffer + 5, sizeof(buffer) - 5));
+    EXPECT_EQ("helloworld", std::string(buffer, 10));
+}
+
+TEST_F(TestBufferedSerial2RxDma, delimiter_ends_the_transfer)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    char buffer[sizeof(rx_buf)];
+
+    port.sigio(mbed::callback(this, &TestBufferedSerial2RxDma::signal));
+    port.set_rx_notify(sizeof(rx_buf), '\n');
+    EXPECT_EQ(3u, FakeHal::receive("ab\n", 3));
+    EXPECT_EQ(1u, signals);
+    EXPECT_EQ(3, port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ("ab\n", std::string(buffer, 3));
+}
+
+TEST_F(TestBufferedSerial2RxDma, idle_line_interrupt_publishes_the_frame)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+
+    port.sigio(mbed::callback(this, &TestBufferedSerial2RxDma::signal));
+    port.set_rx_notify(5);
+    EXPECT_EQ(5u, FakeHal::receive("hello", 5));
+    EXPECT_EQ(0u, signals);
+    FakeHal::interrupt([&] {
+        port.rx_idle();
+    });
+    EXPECT_EQ(1u, signals);
+    EXPECT_TRUE(port.readable());
+}
+
+TEST_F(TestBufferedSerial2RxDma, short_frames_wake_a_blocking_reader)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    char buffer[16];
+
+    // nothing else would end the wait before the timer
+    port.set_blocking(true);
+    port.set_read_timing(0, 1000);
+    FakeHal::start(0);
+    std::thread sender([] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        FakeHal::receive("hello", 5);
+    });
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_EQ(5, port.read(buffer, 5));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    sender.join();
+    EXPECT_EQ("hello", std::string(buffer, 5));
+}
@@ -0,0 +1,99 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "BufferedSerial2.h"
+#include "FakeHal.h"
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// CycleCounter counts nanoseconds on the host
+const uint32_t wait_ticks = 5000000;
+
+void wait()
+{
+    std::this_thread::sleep_for(std::chrono::nanoseconds(wait_ticks));
+}
+
+}
+
+class TestBufferedSerial2Latency : public testing::Test {
+protected:
+    TestBufferedSerial2Latency() : port((FakeHal::reset(), NC), NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf))
+    {
+    }
+
+    ~TestBufferedSerial2Latency()
+    {
+        FakeHal::stop();
+    }
+
+    char rx_buf[64];
+    char tx_buf[32];
+    BufferedSerial2 port;
+};
+
+TEST_F(TestBufferedSerial2Latency, received_byte_is_timed_until_read)
+{
+    char buffer[4];
+
+    EXPECT_EQ(1u, FakeHal::receive("a", 1));
+    wait();
+    EXPECT_EQ(1, port.read(buffer, sizeof(buffer)));
+
+    BufferedSerial2Latency latency = port.get_rx_latency();
+    EXPECT_EQ(1u, latency.samples);
+    EXPECT_GE(latency.p50, wait_ticks);
+    EXPECT_EQ(latency.max, latency.p999);
+    EXPECT_EQ(1000000000u, latency.ticks_hz);
+    EXPECT_EQ(0u, port.get_tx_latency().samples);
+}
+
+TEST_F(TestBufferedSerial2Latency, the_last_byte_queued_is_the_one_timed)
+{
+    char buffer[4];
+
+    EXPECT_EQ(3u, FakeHal::receive("abc", 3));
+    EXPECT_EQ(2, port.read(buffer, 2));
+    EXPECT_EQ(0u, port.get_rx_latency().samples);
+    EXPECT_EQ(1, port.read(buffer, 1));
+    EXPECT_EQ(1u, port.get_rx_latency().samples);
+
+    // the next sample starts with the next byte received
+    EXPECT_EQ(1u, FakeHal::receive("e", 1));
+    EXPECT_EQ(1, port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(2u, port.get_rx_latency().samples);
+}
+
+TEST_F(TestBufferedSerial2Latency, written_byte_is_timed_until_sent)
+{
+    // the hardware fifo takes the first byte at once, the others wait for the line
+    EXPECT_EQ(3, port.write("abc", 3));
+    wait();
+    FakeHal::transmit();
+
+    BufferedSerial2Latency latency = port.get_tx_latency();
+    EXPECT_EQ(1u, latency.samples);
+    EXPECT_GE(latency.p50, wait_ticks);
+
+    port.reset_latency();
+    EXPECT_EQ(0u, port.get_tx_latency().samples);
+    EXPECT_EQ(0u, port.get_tx_latency().max);
+    EXPECT_EQ("abc", FakeHal::take_line());
+}
@@ -0,0 +1,124 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "BufferedSerial2.h"
+#include "FakeHal.h"
+#include <math.h>
+#include <stdio.h>
+#include <wchar.h>
+#include <string>
+
+class TestBufferedSerial2Printf : public testing::Test {
+protected:
+    TestBufferedSerial2Printf() : port((FakeHal::reset(), NC), NC)
+    {
+    }
+
+    ~TestBufferedSerial2Printf()
+    {
+        FakeHal::stop();
+    }
+
+    // formats with the port and with snprintf, the line must show the same
+    template<typename... Args>
+    void expect_like_snprintf(const char *format, Args... args)
+    {
+        char expected[256];
+        int length = snprintf(expected, sizeof(expected), format, args...);
+
+        EXPECT_EQ(length, port.printf(format, args...)) << format;
+        FakeHal::transmit();
+        EXPECT_EQ(std::string(expected), FakeHal::take_line()) << format;
+    }
+
+    BufferedSerial2Static<64, 512> port;
+};
+
+TEST_F(TestBufferedSerial2Printf, integers)
+{
+    expect_like_snprintf("hello %d %i %u|%5d|%-5d|%05d|%+d|% d|%.3d|%5.3d|%.0d|", 42, -7, 4000000000u, 12, 12, -12, 5, 5, 7, 7, 0);
+    expect_like_snprintf("%x %X %#x %#X %o %08x %#010x %.0x %#.0x|", 255u, 255u, 255u, 0u, 8u, 0xbeefu, 0xbeefu, 0u, 0u);
+    expect_like_snprintf("%lld %llu %lx %hhd %hu %zu %ld %jd %td", -9223372036854775807LL - 1, 18446744073709551615ULL,
+                         0xdeadbeefUL, 300, 70000, (size_t)99, -123456789L, (intmax_t)-1, (ptrdiff_t)-2);
+    expect_like_snprintf("%p %p", (void *)0x1234, (void *)&port);
+}
+
+TEST_F(TestBufferedSerial2Printf, octal_alternative_form_has_one_leading_zero)
+{
+    expect_like_snprintf("%#o|%#o|%#.0o|%#5o|%#.3o|%#.3o|%#o", 0u, 8u, 0u, 0u, 8u, 0u, 01234u);
+}
+
+TEST_F(TestBufferedSerial2Printf, strings_and_characters)
+{
+    expect_like_snprintf("%s|%10s|%-10s|%.2s|%c|%3c|%%|%*d|%-*d|%.*s", "abc", "abc", "abc", "abc", 'x', 'y', 6, 1, 6, 2, 2, "xyz");
+}
+
+TEST_F(TestBufferedSerial2Printf, fixed_point)
+{
+    // no ties: those round away from 0 here, but to even in snprintf
+    expect_like_snprintf("%f %.2f %.0f %#.0f %10.3f %-10.3f| %+.1f %08.3f %.9f %f", 3.14159, -2.556, 2.7, 3.0, 1.0 / 3, -1.5,
+                         0.06, -3.25, 0.123456789, 1e15);
+    expect_like_snprintf("%.12f %f %.3f %F", 1.5, 123456789.125, 999.9996, 0.5);
+}
+
+TEST_F(TestBufferedSerial2Printf, infinity_and_nan_follow_the_case_of_the_conversion)
+{
+    expect_like_snprintf("%f|%F|%f|%F|%F|%5F|%-5f|%+F", INFINITY, INFINITY, -INFINITY, -INFINITY, NAN, NAN, NAN, INFINITY);
+}
+
+TEST_F(TestBufferedSerial2Printf, negative_zero_keeps_its_sign)
+{
+    expect_like_snprintf("%f|%.0f|%+.1f|%08.2f|%f", -0.0, -0.0, -0.0, -0.0, 0.0);
+}
+
+TEST_F(TestBufferedSerial2Printf, long_double_is_taken_as_such)
+{
+    expect_like_snprintf("%Lf %.2Lf %d", 1.5L, -2.25L, 7);
+}
+
+TEST_F(TestBufferedSerial2Printf, exponent_forms_go_through_stdio)
+{
+    expect_like_snprintf("%e %E %.3e %g %G %g %a %d", 12345.678, 0.00012, -1.0 / 3, 0.0001, 1e20, 100.0, 1.0, 42);
+    expect_like_snprintf("%Le %Lg %s", 1.25L, 1e-10L, "end");
+}
+
+TEST_F(TestBufferedSerial2Printf, unsupported_flags_and_conversions_go_through_stdio)
+{
+    expect_like_snprintf("%'d %d %s", 1234567, 5, "end");
+    expect_like_snprintf("%ls|%lc|%d", L"wide", (wint_t)'w', 3);
+
+    int expected = -1;
+    int count = -1;
+    EXPECT_EQ(6, port.printf("abc%n%d", &count, 123));
+    snprintf(NULL, 0, "abc%n%d", &expected, 123);
+    EXPECT_EQ(expected, count);
+    FakeHal::transmit();
+    EXPECT_EQ("abc123", FakeHal::take_line());
+}
+
+TEST_F(TestBufferedSerial2Printf, output_larger_than_the_buffer_waits_for_the_line)
+{
+    std::string text(2000, 'x');
+
+    FakeHal::start(0);
+    EXPECT_EQ((int)text.size() + 5, port.printf("%s %d", text.c_str(), 1234));
+    EXPECT_EQ(0, port.sync());
+    FakeHal::stop();
+    FakeHal::transmit();
+    EXPECT_EQ(text + " 1234", FakeHal::take_line());
+}
@@ -0,0 +1,362 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "BufferedSerial2.h"
+#include "FakeHal.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+uint32_t elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+}
+
+class TestBufferedSerial2Rx : public testing::Test {
+protected:
+    TestBufferedSerial2Rx()
+    {
+        FakeHal::reset();
+    }
+
+    ~TestBufferedSerial2Rx()
+    {
+        if (sender.joinable()) {
+            sender.join();
+        }
+        FakeHal::stop();
+    }
+
+    // receive the pieces one after the other, delay_ms apart, starting delay_ms from now
+    void send_later(uint32_t delay_ms, std::initializer_list<std::string> pieces)
+    {
+        std::vector<std::string> data(pieces);
+        sender = std::thread([delay_ms, data] {
+            for (size_t i = 0; i < data.size(); i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+                FakeHal::receive(data[i].data(), data[i].size());
+            }
+        });
+    }
+
+    char rx_buf[64];
+    char tx_buf[32];
+    std::thread sender;
+};
+
+TEST_F(TestBufferedSerial2Rx, getc_returns_byte_0xff_as_255)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+
+    EXPECT_EQ(2u, FakeHal::receive("\xff\x80", 2));
+    EXPECT_EQ(0xff, port.getc());
+    EXPECT_EQ(0x80, port.getc());
+
+    port.set_blocking(true);
+    port.set_read_timing(0, 10);
+    EXPECT_EQ(1u, FakeHal::receive("\xff", 1));
+    EXPECT_EQ(0xff, port.getc());
+    EXPECT_EQ(EOF, port.getc());
+}
+
+TEST_F(TestBufferedSerial2Rx, non_blocking_read_returns_what_is_buffered)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    char buffer[16];
+
+    EXPECT_EQ(-EAGAIN, port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(3u, FakeHal::receive("abc", 3));
+    EXPECT_EQ(3, port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ("abc", std::string(buffer, 3));
+}
+
+TEST_F(TestBufferedSerial2Rx, read_copies_across_the_end_of_the_buffer)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string first = FakeHal::pattern(40, 1);
+    std::string second = FakeHal::pattern(50, 2);
+    char buffer[sizeof(rx_buf)];
+
+    EXPECT_EQ(first.size(), FakeHal::receive(first.data(), first.size()));
+    EXPECT_EQ((ssize_t)first.size(), port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(first, std::string(buffer, first.size()));
+
+    // wraps around the end of rx_buf, one read still returns all of it
+    EXPECT_EQ(second.size(), FakeHal::receive(second.data(), second.size()));
+    EXPECT_EQ((ssize_t)second.size(), port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(second, std::string(buffer, second.size()));
+}
+
+TEST_F(TestBufferedSerial2Rx, read_leaves_the_rest_for_the_next_read)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(30);
+    char buffer[sizeof(rx_buf)];
+
+    EXPECT_EQ(0, port.read(buffer, 0));
+    EXPECT_EQ(data.size(), FakeHal::receive(data.data(), data.size()));
+    EXPECT_EQ(0, port.read(buffer, 0));
+    EXPECT_EQ(12, port.read(buffer, 12));
+    EXPECT_EQ(18, port.read(buffer + 12, sizeof(buffer) - 12));
+    EXPECT_EQ(data, std::string(buffer, data.size()));
+    EXPECT_EQ(-EAGAIN, port.read(buffer, sizeof(buffer)));
+}
+
+TEST_F(TestBufferedSerial2Rx, blocking_getc_sleeps_until_a_byte_arrives)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+
+    port.set_blocking(true);
+    send_later(20, {"\xff"});
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_EQ(0xff, port.getc());
+    EXPECT_GE(elapsed_ms(start), 15u);
+}
+
+TEST_F(TestBufferedSerial2Rx, blocking_read_waits_for_the_whole_request_by_default)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    char buffer[6];
+
+    port.set_blocking(true);
+    send_later(10, {"ab", "cd", "ef"});
+    EXPECT_EQ(6, port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ("abcdef", std::string(buffer, 6));
+}
+
+TEST_F(TestBufferedSerial2Rx, vmin_returns_once_that_many_bytes_arrived)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    char buffer[16];
+
+    port.set_blocking(true);
+    port.set_read_timing(4, 0);
+    send_later(10, {"ab", "cd"});
+    EXPECT_EQ(4, port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ("abcd", std::string(buffer, 4));
+}
+
+TEST_F(TestBufferedSerial2Rx, vtime_ends_the_read_after_a_gap)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    char buffer[16];
+
+    // the timer only starts with the first byte
+    port.set_blocking(true);
+    port.set_read_timing(SIZE_MAX, 30);
+    send_later(50, {"a\xff" "c"});
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_EQ(3, port.read(buffer, sizeof(buffer)));
+    EXPECT_GE(elapsed_ms(start), 75u);
+    EXPECT_EQ("a\xff" "c", std::string(buffer, 3));
+}
+
+TEST_F(TestBufferedSerial2Rx, vmin_0_times_out_from_the_call)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    char buffer[16];
+
+    port.set_blocking(true);
+    port.set_read_timing(0, 20);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_EQ(-EAGAIN, port.read(buffer, sizeof(buffer)));
+    EXPECT_GE(elapsed_ms(start), 20u);
+
+    // a byte that comes in time returns right away
+    send_later(5, {"x"});
+    EXPECT_EQ(1, port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ('x', buffer[0]);
+}
+
+TEST_F(TestBufferedSerial2Rx, get_returns_bytes_like_getc)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+
+    EXPECT_EQ(2u, FakeHal::receive("\xffz", 2));
+    EXPECT_EQ(0xff, port.get());
+    EXPECT_EQ('z', port.get());
+
+    // an empty buffer goes to getc()
+    port.set_blocking(true);
+    port.set_read_timing(0, 10);
+    EXPECT_EQ(EOF, port.get());
+    send_later(5, {"\xff"});
+    EXPECT_EQ(0xff, port.get());
+}
+
+// a full rx buffer receives 10 more bytes than it holds, through several rx interrupts
+class TestBufferedSerial2RxOverflow : public TestBufferedSerial2Rx {
+protected:
+    std::string overflow(mbed::CircularBuffer2Overflow policy)
+    {
+        BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+        std::string data = std::string(sizeof(rx_buf), 'o') + std::string(10, 'n');
+        char buffer[sizeof(rx_buf) + 10];
+
+        port.set_rx_overflow(policy);
+        EXPECT_EQ(data.size(), FakeHal::receive(data.data(), data.size()));
+        dropped = port.rx_dropped();
+        ssize_t length = port.read(buffer, sizeof(buffer));
+        return std::string(buffer, length > 0 ? length : 0);
+    }
+
+    uint32_t dropped = 0;
+};
+
+TEST_F(TestBufferedSerial2RxOverflow, overwrite_oldest_keeps_the_newest_bytes)
+{
+    EXPECT_EQ(std::string(sizeof(rx_buf) - 10, 'o') + std::string(10, 'n'), overflow(mbed::CircularBuffer2OverwriteOldest));
+    EXPECT_EQ(10u, dropped);
+}
+
+TEST_F(TestBufferedSerial2RxOverflow, drop_newest_keeps_the_oldest_bytes)
+{
+    EXPECT_EQ(std::string(sizeof(rx_buf), 'o'), overflow(mbed::CircularBuffer2DropNewest));
+    EXPECT_EQ(10u, dropped);
+}
+
+TEST_F(TestBufferedSerial2RxOverflow, reject_keeps_the_oldest_bytes)
+{
+    EXPECT_EQ(std::string(sizeof(rx_buf), 'o'), overflow(mbed::CircularBuffer2Reject));
+    EXPECT_EQ(10u, dropped);
+}
+
+TEST_F(TestBufferedSerial2Rx, bytes_are_read_in_place_up_to_the_end_of_the_buffer)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(30);
+    char buffer[sizeof(rx_buf)];
+    size_t length = 0;
+
+    EXPECT_EQ(50u, FakeHal::receive(FakeHal::pattern(50).data(), 50));
+    EXPECT_EQ(50, port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(data.size(), FakeHal::receive(data.data(), data.size()));
+
+    const char *first = port.peek_contiguous(length);
+    EXPECT_EQ(rx_buf + 50, first);
+    EXPECT_EQ(data.substr(0, 14), std::string(first, length));
+    port.consume(length);
+    const char *second = port.peek_contiguous(length);
+    EXPECT_EQ(rx_buf, second);
+    EXPECT_EQ(data.substr(14), std::string(second, length));
+    port.consume(length);
+    EXPECT_EQ(-EAGAIN, port.read(buffer, sizeof(buffer)));
+}
+
+TEST_F(TestBufferedSerial2Rx, rx_interrupt_empties_the_whole_fifo)
+{
+    std::string first = FakeHal::pattern(40, 1);
+    std::string second = FakeHal::pattern(sizeof(rx_buf), 2);
+    char buffer[sizeof(rx_buf)];
+
+    // one interrupt for the whole second block, which wraps around the end of rx_buf
+    FakeHal::reset(1, sizeof(rx_buf));
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    EXPECT_EQ(first.size(), FakeHal::receive(first.data(), first.size()));
+    EXPECT_EQ((ssize_t)first.size(), port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(second.size(), FakeHal::receive(second.data(), second.size()));
+    EXPECT_EQ((ssize_t)second.size(), port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(second, std::string(buffer, second.size()));
+    EXPECT_EQ(0u, port.rx_dropped());
+}
+
+class TestBufferedSerial2RxNotify : public TestBufferedSerial2Rx {
+protected:
+    TestBufferedSerial2RxNotify() : port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf)), calls(0)
+    {
+        port.sigio(mbed::callback(this, &TestBufferedSerial2RxNotify::notified));
+    }
+
+    void notified()
+    {
+        calls++;
+    }
+
+    void receive(const std::string &data)
+    {
+        EXPECT_EQ(data.size(), FakeHal::receive(data.data(), data.size()));
+    }
+
+    void read_all()
+    {
+        char buffer[sizeof(rx_buf)];
+        while (port.read(buffer, sizeof(buffer)) > 0) {
+        }
+    }
+
+    BufferedSerial2 port;
+    unsigned calls;
+};
+
+TEST_F(TestBufferedSerial2RxNotify, sigio_comes_once_the_threshold_is_reached)
+{
+    port.set_rx_notify(8);
+    receive("abcde");
+    EXPECT_EQ(0u, calls);
+    receive("fgh");
+    EXPECT_EQ(1u, calls);
+
+    // edge triggered: nothing more until the application has read
+    receive("ijklmnop");
+    EXPECT_EQ(1u, calls);
+    read_all();
+    receive("1234567");
+    EXPECT_EQ(1u, calls);
+    receive("8");
+    EXPECT_EQ(2u, calls);
+}
+
+TEST_F(TestBufferedSerial2RxNotify, delimiter_notifies_below_the_threshold)
+{
+    port.set_rx_notify(32, '\n');
+    receive("ab");
+    EXPECT_EQ(0u, calls);
+    receive("c\nd");
+    EXPECT_EQ(1u, calls);
+}
+
+TEST_F(TestBufferedSerial2RxNotify, coalescing_notifies_a_while_after_the_first_byte)
+{
+    port.set_rx_notify(32, -1, 1000);
+    receive("a");
+    receive("b");
+    EXPECT_EQ(0u, calls);
+    EXPECT_EQ(1u, FakeHal::timeouts_armed());
+    FakeHal::fire_timeouts(true);
+    EXPECT_EQ(1u, calls);
+
+    // reaching the threshold first cancels the timer
+    read_all();
+    receive("x");
+    EXPECT_EQ(1u, FakeHal::timeouts_armed());
+    receive(FakeHal::pattern(31));
+    EXPECT_EQ(2u, calls);
+    EXPECT_EQ(0u, FakeHal::timeouts_armed());
+}
+
+TEST_F(TestBufferedSerial2RxNotify, no_notifications_after_sigio_is_cleared)
+{
+    port.sigio(NULL);
+    receive("abc");
+    EXPECT_EQ(0u, calls);
+}
@@ -0,0 +1,134 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "BufferedSerial2.h"
+#include "FakeHal.h"
+#include <string>
+
+class TestBufferedSerial2Stats : public testing::Test {
+protected:
+    TestBufferedSerial2Stats() : port((FakeHal::reset(4), NC), NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf))
+    {
+    }
+
+    ~TestBufferedSerial2Stats()
+    {
+        FakeHal::stop();
+    }
+
+    char rx_buf[64];
+    char tx_buf[32];
+    BufferedSerial2 port;
+};
+
+TEST_F(TestBufferedSerial2Stats, counts_bytes_and_interrupts)
+{
+    EXPECT_EQ(20, port.write("0123456789abcdefghij", 20));
+    FakeHal::transmit();
+    EXPECT_EQ(5u, FakeHal::receive("hello", 5));
+
+    BufferedSerial2Stats stats = port.get_stats();
+    EXPECT_EQ(20u, stats.tx_bytes);
+    EXPECT_GE(stats.tx_irqs, 1u);
+    EXPECT_LT(stats.tx_irqs, 20u);
+    EXPECT_EQ(5u, stats.rx_bytes);
+    EXPECT_EQ(1u, stats.rx_irqs);
+    EXPECT_EQ(0u, stats.rx_dropped);
+    EXPECT_EQ(0u, stats.tx_blocked_us);
+    EXPECT_EQ(0u, stats.tx_drain_us);
+}
+
+TEST_F(TestBufferedSerial2Stats, one_rx_interrupt_per_full_fifo)
+{
+    std::string data = FakeHal::pattern(40);
+    char buffer[sizeof(rx_buf)];
+
+    // the fake rx fifo holds 16 bytes, the last 8 raise an interrupt of their own
+    EXPECT_EQ(data.size(), FakeHal::receive(data.data(), data.size()));
+    BufferedSerial2Stats stats = port.get_stats();
+    EXPECT_EQ(data.size(), stats.rx_bytes);
+    EXPECT_EQ(3u, stats.rx_irqs);
+    EXPECT_EQ((ssize_t)data.size(), port.read(buffer, sizeof(buffer)));
+    EXPECT_EQ(data, std::string(buffer, data.size()));
+}
+
+TEST_F(TestBufferedSerial2Stats, bytes_lost_to_a_full_rx_buffer_are_still_received)
+{
+    std::string data(sizeof(rx_buf) + 6, 'x');
+
+    EXPECT_EQ(data.size(), FakeHal::receive(data.data(), data.size()));
+    BufferedSerial2Stats stats = port.get_stats();
+    EXPECT_EQ(data.size(), stats.rx_bytes);
+    EXPECT_EQ(6u, stats.rx_dropped);
+}
+
+TEST_F(TestBufferedSerial2Stats, blocked_writes_and_sync_are_timed_apart)
+{
+    std::string data(sizeof(tx_buf) + 8, 'x');
+
+    port.set_tx_timeout(20);
+    EXPECT_EQ((ssize_t)sizeof(tx_buf), port.write(data.data(), data.size()));
+    BufferedSerial2Stats stats = port.get_stats();
+    EXPECT_GE(stats.tx_blocked_us, 20000u);
+    EXPECT_EQ(0u, stats.tx_drain_us);
+
+    EXPECT_EQ(-ETIMEDOUT, port.sync());
+    BufferedSerial2Stats after = port.get_stats();
+    EXPECT_EQ(stats.tx_blocked_us, after.tx_blocked_us);
+    EXPECT_GE(after.tx_drain_us, 20000u);
+    FakeHal::transmit();
+}
+
+TEST_F(TestBufferedSerial2Stats, reset_restarts_every_counter)
+{
+    std::string data(sizeof(rx_buf) + 1, 'x');
+
+    EXPECT_EQ(3, port.write("abc", 3));
+    FakeHal::transmit();
+    EXPECT_EQ(data.size(), FakeHal::receive(data.data(), data.size()));
+    port.reset_stats();
+
+    BufferedSerial2Stats stats = port.get_stats();
+    EXPECT_EQ(0u, stats.tx_bytes);
+    EXPECT_EQ(0u, stats.tx_irqs);
+    EXPECT_EQ(0u, stats.rx_bytes);
+    EXPECT_EQ(0u, stats.rx_irqs);
+    EXPECT_EQ(0u, stats.rx_dropped);
+
+    EXPECT_EQ(2, port.write("de", 2));
+    FakeHal::transmit();
+    EXPECT_EQ(2u, port.get_stats().tx_bytes);
+}
+
+TEST_F(TestBufferedSerial2Stats, no_bytes_are_lost_to_concurrent_updates)
+{
+    std::string data(5000, 'x');
+    size_t offset = 0;
+
+    // writers start the transmitter from the thread while the interrupt keeps it going
+    port.set_tx_timeout(2000);
+    FakeHal::start(0);
+    while (offset < data.size()) {
+        ASSERT_EQ(7, port.write(&data[offset], 7));
+        offset += 7;
+    }
+    ASSERT_EQ(0, port.sync());
+    FakeHal::stop();
+    EXPECT_EQ(offset, port.get_stats().tx_bytes);
+    FakeHal::take_line();
+}
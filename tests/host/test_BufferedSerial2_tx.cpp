@@ -0,0 +1,292 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "BufferedSerial2.h"
+#include "FakeHal.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+const size_t tx_fifo_depth = 4;
+
+uint32_t elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+}
+
+class TestBufferedSerial2Tx : public testing::Test {
+protected:
+    TestBufferedSerial2Tx()
+    {
+        FakeHal::reset(tx_fifo_depth);
+    }
+
+    ~TestBufferedSerial2Tx()
+    {
+        FakeHal::stop();
+    }
+
+    char rx_buf[64];
+    char tx_buf[32];
+};
+
+TEST_F(TestBufferedSerial2Tx, sync_returns_once_everything_is_sent)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(200);
+
+    FakeHal::start(0);
+    EXPECT_EQ((ssize_t)data.size(), port.write(data.data(), data.size()));
+    EXPECT_EQ(0, port.sync());
+    FakeHal::stop();
+    FakeHal::transmit();
+    EXPECT_EQ(data, FakeHal::take_line());
+}
+
+TEST_F(TestBufferedSerial2Tx, sync_times_out_while_the_line_stalls)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(10);
+
+    port.set_tx_timeout(20);
+    EXPECT_EQ((ssize_t)data.size(), port.write(data.data(), data.size()));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_EQ(-ETIMEDOUT, port.sync());
+    EXPECT_GE(elapsed_ms(start), 20u);
+
+    FakeHal::transmit();
+    EXPECT_EQ(0, port.sync());
+    EXPECT_EQ(data, FakeHal::take_line());
+}
+
+TEST_F(TestBufferedSerial2Tx, write_times_out_while_the_buffer_stays_full)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(64);
+
+    port.set_tx_timeout(20);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // fills the buffer, then waits in vain for it to drain to the low watermark
+    EXPECT_EQ((ssize_t)sizeof(tx_buf), port.write(data.data(), data.size()));
+    EXPECT_GE(elapsed_ms(start), 20u);
+
+    // the hardware fifo took some, single bytes fit until the buffer is full again
+    for (size_t i = 0; i < tx_fifo_depth; i++) {
+        EXPECT_EQ('!', port.putc('!'));
+    }
+    start = std::chrono::steady_clock::now();
+    EXPECT_EQ(EOF, port.putc('?'));
+    EXPECT_GE(elapsed_ms(start), 20u);
+
+    FakeHal::transmit();
+    EXPECT_EQ(data.substr(0, sizeof(tx_buf)) + std::string(tx_fifo_depth, '!'), FakeHal::take_line());
+}
+
+TEST_F(TestBufferedSerial2Tx, puts_returns_what_fit)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(40);
+
+    port.set_tx_timeout(10);
+    EXPECT_EQ(6, port.puts("hello"));
+    EXPECT_EQ(1, port.puts(""));
+    // the newline doesn't fit after the string, then nothing does
+    EXPECT_EQ((int)(sizeof(tx_buf) - 6 - 1 + tx_fifo_depth), port.puts(data.substr(0, sizeof(tx_buf) - 7 + tx_fifo_depth).c_str()));
+    EXPECT_EQ(-EAGAIN, port.puts(""));
+    EXPECT_EQ(-EAGAIN, port.puts(data.c_str()));
+
+    FakeHal::transmit();
+    EXPECT_EQ(16, port.puts(data.substr(0, 15).c_str()));
+    FakeHal::transmit();
+    EXPECT_EQ("hello\n\n" + data.substr(0, sizeof(tx_buf) - 7 + tx_fifo_depth) + data.substr(0, 15) + "\n", FakeHal::take_line());
+}
+
+TEST_F(TestBufferedSerial2Tx, put_writes_like_putc)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(sizeof(tx_buf) + tx_fifo_depth);
+
+    port.set_tx_timeout(10);
+    for (size_t i = 0; i < data.size(); i++) {
+        EXPECT_EQ(data[i], port.put(data[i]));
+    }
+    // a full buffer goes to putc(), which waits for the transmitter
+    EXPECT_EQ(EOF, port.put('?'));
+
+    FakeHal::transmit();
+    EXPECT_EQ(0xff, port.put(0xff));
+    FakeHal::transmit();
+    EXPECT_EQ(data + "\xff", FakeHal::take_line());
+}
+
+TEST_F(TestBufferedSerial2Tx, static_port_works_with_sizes_fixed_at_compile_time)
+{
+    // not a power of two, so the index arithmetic wraps at 2 * TxN
+    BufferedSerial2Static<16, 24> port(NC, NC);
+    std::string data = FakeHal::pattern(200);
+
+    EXPECT_EQ(24u, port.tx_capacity);
+    FakeHal::start(0);
+    EXPECT_EQ((ssize_t)data.size(), port.write(data.data(), data.size()));
+    EXPECT_EQ(0, port.sync());
+    FakeHal::stop();
+    FakeHal::transmit();
+    EXPECT_EQ(data, FakeHal::take_line());
+}
+
+// Unstalls the line at the 1st, 2nd, ... preemption point of op, until op gets
+// through all of them: an interrupt there runs the transmitter dry, then the
+// line keeps going. A waiter that misses that interrupt's wakeup gets no other
+// one and times out. Once op blocks before the point, nothing unstalls the
+// line and it times out too, which ends the sweep
+template<typename Op>
+static void sweep_preemption_points(Op op)
+{
+    for (unsigned point = 1; point < 100; point++) {
+        FakeHal::at_unmask(point, [] {
+            FakeHal::transmit();
+            FakeHal::start(0);
+        });
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool done = op(point);
+        bool reached = !FakeHal::unmask_pending();
+        FakeHal::at_unmask(0, NULL);
+        FakeHal::stop();
+        FakeHal::transmit();
+        if (!reached) {
+            EXPECT_FALSE(done) << "point " << point;
+            return;
+        }
+        EXPECT_TRUE(done) << "wakeup lost at point " << point;
+        EXPECT_LT(elapsed_ms(start), 100u) << "point " << point;
+    }
+    ADD_FAILURE() << "too many preemption points";
+}
+
+TEST_F(TestBufferedSerial2Tx, sync_wakeup_is_not_lost_wherever_the_interrupt_hits)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string sent;
+
+    port.set_tx_timeout(200);
+    sweep_preemption_points([&](unsigned point) {
+        std::string data = FakeHal::pattern(20, point);
+        sent += data;
+        EXPECT_EQ((ssize_t)data.size(), port.write(data.data(), data.size()));
+        return port.sync() == 0;
+    });
+    EXPECT_EQ(0, port.sync());
+    EXPECT_EQ(sent, FakeHal::take_line());
+}
+
+TEST_F(TestBufferedSerial2Tx, write_wakeup_is_not_lost_wherever_the_interrupt_hits)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string sent;
+
+    port.set_tx_timeout(200);
+    sweep_preemption_points([&](unsigned point) {
+        // fill up to the high watermark first, the second write then has to wait
+        std::string data = FakeHal::pattern(sizeof(tx_buf) + 8, point);
+        EXPECT_EQ((ssize_t)sizeof(tx_buf), port.write(data.data(), sizeof(tx_buf)));
+        ssize_t written = port.write(&data[sizeof(tx_buf)], 8);
+        sent += data.substr(0, sizeof(tx_buf) + (written > 0 ? written : 0));
+        return written == 8;
+    });
+    FakeHal::transmit();
+    EXPECT_EQ(sent, FakeHal::take_line());
+}
+
+#if MBED_CONF_RTOS_PRESENT
+TEST_F(TestBufferedSerial2Tx, tx_interrupts_send_no_wakeups_without_a_waiter)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(sizeof(tx_buf));
+
+    rtos::EventFlags::set_calls() = 0;
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ((ssize_t)data.size(), port.write(data.data(), data.size()));
+        FakeHal::transmit();
+    }
+    EXPECT_EQ(0u, rtos::EventFlags::set_calls());
+
+    // a sleeping writer is still woken, once the buffer is down to the low watermark
+    FakeHal::start(0);
+    EXPECT_EQ((ssize_t)data.size(), port.write(data.data(), data.size()));
+    EXPECT_EQ((ssize_t)data.size(), port.write(data.data(), data.size()));
+    EXPECT_EQ(0, port.sync());
+    EXPECT_NE(0u, rtos::EventFlags::set_calls());
+}
+
+TEST_F(TestBufferedSerial2Tx, one_wakeup_releases_every_thread_in_sync)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(20);
+    int results[2] = {1, 1};
+
+    port.set_tx_timeout(500);
+    EXPECT_EQ((ssize_t)data.size(), port.write(data.data(), data.size()));
+    std::thread first([&] { results[0] = port.sync(); });
+    std::thread second([&] { results[1] = port.sync(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // the last tx interrupt sets the empty flag once, both waiters must see it
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    FakeHal::transmit();
+    first.join();
+    second.join();
+    EXPECT_EQ(0, results[0]);
+    EXPECT_EQ(0, results[1]);
+    EXPECT_LT(elapsed_ms(start), 100u);
+    EXPECT_EQ(data, FakeHal::take_line());
+}
+#endif
+
+TEST_F(TestBufferedSerial2Tx, blocking_writes_keep_order_against_a_running_line)
+{
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+    std::string data = FakeHal::pattern(5000);
+    size_t offset = 0;
+    unsigned chunk = 1;
+
+    port.set_tx_timeout(2000);
+    FakeHal::start(0);
+    while (offset < data.size()) {
+        size_t length = std::min<size_t>(chunk, data.size() - offset);
+        if (chunk % 3 == 0) {
+            for (size_t i = 0; i < length; i++) {
+                ASSERT_EQ((unsigned char)data[offset + i], port.putc(data[offset + i]));
+            }
+        } else {
+            ASSERT_EQ((ssize_t)length, port.write(&data[offset], length));
+        }
+        if (chunk % 17 == 0) {
+            ASSERT_EQ(0, port.sync());
+        }
+        offset += length;
+        chunk = chunk % 61 + 1;
+    }
+    ASSERT_EQ(0, port.sync());
+    FakeHal::stop();
+    FakeHal::transmit();
+    EXPECT_EQ(data, FakeHal::take_line());
+}
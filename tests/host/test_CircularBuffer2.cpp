@@ -0,0 +1,225 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "CircularBuffer2.h"
+#include "FakeHal.h"
+#include <deque>
+#include <string>
+
+using namespace mbed;
+
+namespace {
+
+template<typename Buffer>
+uint32_t histogram_total(const Buffer &buf)
+{
+    uint32_t total = 0;
+    for (unsigned b = 0; b < Buffer::histogram_buckets; b++) {
+        total += buf.histogram(b);
+    }
+    return total;
+}
+
+}
+
+TEST(TestCircularBuffer2, occupancy_samples_only_stored_elements)
+{
+    static const CircularBuffer2Overflow policies[] = {CircularBuffer2DropNewest, CircularBuffer2Reject};
+
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        char pool[4];
+        CircularBuffer2<char> buf(pool, sizeof(pool));
+
+        buf.set_overflow(policies[i]);
+        for (char c = 'a'; c < 'g'; c++) {
+            buf.push(c);
+        }
+        EXPECT_EQ(2u, buf.dropped());
+        EXPECT_EQ(4u, buf.high_water());
+        // levels 1, 2, 3 and 4
+        EXPECT_EQ(1u, buf.histogram(0));
+        EXPECT_EQ(1u, buf.histogram(1));
+        EXPECT_EQ(2u, buf.histogram(2));
+        EXPECT_EQ(4u, histogram_total(buf));
+    }
+}
+
+TEST(TestCircularBuffer2, overwritten_elements_are_stored_at_the_full_level)
+{
+    char pool[4];
+    CircularBuffer2<char> buf(pool, sizeof(pool));
+    char c = 0;
+
+    for (char in = 'a'; in < 'g'; in++) {
+        EXPECT_TRUE(buf.push(in));
+    }
+    EXPECT_EQ(2u, buf.dropped());
+    // levels 1, 2, 3 and 4, three times
+    EXPECT_EQ(4u, buf.histogram(2));
+    EXPECT_EQ(6u, histogram_total(buf));
+    EXPECT_TRUE(buf.pop(c));
+    EXPECT_EQ('c', c);
+}
+
+TEST(TestCircularBuffer2, peek_contiguous_stops_at_the_end_of_the_pool)
+{
+    char pool[8];
+    CircularBuffer2<char> buf(pool, sizeof(pool));
+    char out[8];
+    size_t length = 0;
+
+    EXPECT_EQ(5u, buf.push("vwxyz", 5));
+    EXPECT_EQ(5u, buf.pop(out, 5));
+    EXPECT_EQ(6u, buf.push("abcdef", 6));
+
+    const char *data = buf.peek_contiguous(length);
+    EXPECT_EQ(pool + 5, data);
+    EXPECT_EQ("abc", std::string(data, length));
+    buf.consume(length);
+
+    // the part that wrapped around
+    data = buf.peek_contiguous(length);
+    EXPECT_EQ(pool, data);
+    EXPECT_EQ("def", std::string(data, length));
+
+    // consume() doesn't go past what is stored
+    buf.consume(10);
+    EXPECT_TRUE(buf.empty());
+    buf.peek_contiguous(length);
+    EXPECT_EQ(0u, length);
+    EXPECT_EQ(2u, buf.push("gh", 2));
+    EXPECT_EQ(2u, buf.pop(out, sizeof(out)));
+    EXPECT_EQ("gh", std::string(out, 2));
+}
+
+// an index policy and capacity, the buffer is checked against a std::deque
+template<typename IndexPolicy, size_t Capacity, typename CounterType = uint32_t>
+struct CircularBuffer2Config {
+    typedef CircularBuffer2<char, CircularBuffer2CriticalSection, IndexPolicy, CounterType> Buffer;
+    static const size_t capacity = Capacity;
+};
+
+template<typename Config>
+class TestCircularBuffer2Indices : public testing::Test {
+};
+
+typedef testing::Types<
+    CircularBuffer2Config<CircularBuffer2AnySize, 6>,
+    CircularBuffer2Config<CircularBuffer2PowerOfTwo, 8>,
+    CircularBuffer2Config<CircularBuffer2FixedSize<6>, 6>,
+    CircularBuffer2Config<CircularBuffer2FixedSize<8>, 8>,
+    // narrow counters, at the largest capacity they allow and below it
+    CircularBuffer2Config<CircularBuffer2AnySize, 100, uint8_t>,
+    CircularBuffer2Config<CircularBuffer2AnySize, 128, uint8_t>,
+    CircularBuffer2Config<CircularBuffer2PowerOfTwo, 128, uint8_t>,
+    CircularBuffer2Config<CircularBuffer2PowerOfTwo, 8, uint8_t>,
+    CircularBuffer2Config<CircularBuffer2FixedSize<128>, 128, uint8_t>,
+    CircularBuffer2Config<CircularBuffer2FixedSize<6>, 6, uint8_t>,
+    CircularBuffer2Config<CircularBuffer2PowerOfTwo, 32768, uint16_t>,
+    CircularBuffer2Config<CircularBuffer2AnySize, 20000, uint16_t>
+> CircularBuffer2Configs;
+TYPED_TEST_SUITE(TestCircularBuffer2Indices, CircularBuffer2Configs);
+
+// blocks and single elements of varying size, so the indices wrap at every offset
+TYPED_TEST(TestCircularBuffer2Indices, behaves_like_a_queue_as_the_indices_wrap)
+{
+    const size_t capacity = TypeParam::capacity;
+    char pool[TypeParam::capacity];
+    typename TypeParam::Buffer buf(pool, capacity);
+    std::deque<char> model;
+    char block[TypeParam::capacity + 1];
+    unsigned seed = 1;
+    char next = 0;
+
+    for (unsigned round = 0; round < 2000; round++) {
+        seed = seed * 1103515245 + 12345;
+        size_t n = (seed >> 16) % (capacity + 2);
+        switch ((seed >> 8) % 4) {
+            case 0: {
+                for (size_t i = 0; i < n; i++) {
+                    block[i] = next++;
+                }
+                size_t pushed = buf.push(block, n);
+                ASSERT_EQ(std::min(n, capacity - model.size()), pushed);
+                model.insert(model.end(), block, block + pushed);
+                break;
+            }
+            case 1: {
+                // overwrites the oldest element when full
+                ASSERT_TRUE(buf.push(next));
+                if (model.size() == capacity) {
+                    model.pop_front();
+                }
+                model.push_back(next++);
+                break;
+            }
+            default: {
+                size_t popped = buf.pop(block, n);
+                ASSERT_EQ(std::min(n, model.size()), popped);
+                for (size_t i = 0; i < popped; i++) {
+                    ASSERT_EQ(model.front(), block[i]) << "round " << round;
+                    model.pop_front();
+                }
+                break;
+            }
+        }
+        ASSERT_EQ(model.size(), buf.size());
+        ASSERT_EQ(model.empty(), buf.empty());
+        ASSERT_EQ(model.size() == capacity, buf.full());
+        ASSERT_EQ(capacity - model.size(), buf.space());
+    }
+}
+
+TEST(TestCircularBuffer2, narrow_counters_shrink_the_buffer)
+{
+    typedef CircularBuffer2<char, CircularBuffer2CriticalSection, CircularBuffer2FixedSize<64>, uint8_t> Narrow;
+    typedef CircularBuffer2<char, CircularBuffer2CriticalSection, CircularBuffer2FixedSize<64>, uint32_t> Wide;
+
+    EXPECT_LT(sizeof(Narrow), sizeof(Wide));
+}
+
+// without BASEPRI the policy falls back to the global critical section, which must still nest
+TEST(TestCircularBuffer2, base_priority_locks_nest_on_the_host)
+{
+    typedef CircularBuffer2BasePriority<2> Lock;
+    bool interrupted = false;
+
+    FakeHal::at_unmask(1, [&] { interrupted = true; });
+    Lock::lock();
+    Lock::lock();
+    Lock::unlock();
+    EXPECT_FALSE(interrupted);
+    Lock::unlock();
+    EXPECT_TRUE(interrupted);
+    EXPECT_FALSE(FakeHal::unmask_pending());
+}
+
+TEST(TestCircularBuffer2, base_priority_buffer_overwrites_like_the_default)
+{
+    char pool[4];
+    CircularBuffer2<char, CircularBuffer2BasePriority<2> > buf(pool, sizeof(pool));
+    char out[4];
+
+    for (char c = 'a'; c < 'f'; c++) {
+        EXPECT_TRUE(buf.push(c));
+    }
+    EXPECT_TRUE(buf.full());
+    EXPECT_EQ(1u, buf.dropped());
+    EXPECT_EQ(4u, buf.pop(out, sizeof(out)));
+    EXPECT_EQ("bcde", std::string(out, 4));
+}
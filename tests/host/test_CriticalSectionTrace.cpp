@@ -0,0 +1,117 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "BufferedSerial2.h"
+#include "CriticalSectionTrace.h"
+#include "FakeHal.h"
+#include <chrono>
+#include <thread>
+
+using namespace mbed;
+
+namespace {
+
+// CycleCounter counts nanoseconds on the host
+const uint32_t wait_ticks = 2000000;
+
+void wait()
+{
+    std::this_thread::sleep_for(std::chrono::nanoseconds(wait_ticks));
+}
+
+}
+
+class TestCriticalSectionTrace : public testing::Test {
+protected:
+    TestCriticalSectionTrace()
+    {
+        FakeHal::reset();
+        CriticalSectionTrace::reset();
+    }
+
+    ~TestCriticalSectionTrace()
+    {
+        FakeHal::stop();
+    }
+};
+
+TEST_F(TestCriticalSectionTrace, nested_sections_are_charged_to_the_outermost)
+{
+    CriticalSectionTrace::enter(1);
+    CriticalSectionTrace::enter(2);
+    wait();
+    CriticalSectionTrace::exit();
+    wait();
+    CriticalSectionTrace::exit();
+
+    EXPECT_EQ(1u, CriticalSectionTrace::histogram(1).count());
+    EXPECT_GE(CriticalSectionTrace::histogram(1).max(), 2 * wait_ticks);
+    EXPECT_EQ(0u, CriticalSectionTrace::histogram(2).count());
+}
+
+TEST_F(TestCriticalSectionTrace, each_site_counts_its_own_sections)
+{
+    for (int i = 0; i < 3; i++) {
+        CriticalSectionTrace::enter(3);
+        CriticalSectionTrace::exit();
+    }
+    CriticalSectionTrace::enter(4);
+    wait();
+    CriticalSectionTrace::exit();
+
+    EXPECT_EQ(3u, CriticalSectionTrace::histogram(3).count());
+    EXPECT_LT(CriticalSectionTrace::histogram(3).max(), wait_ticks);
+    EXPECT_EQ(1u, CriticalSectionTrace::histogram(4).count());
+    EXPECT_GE(CriticalSectionTrace::histogram(4).total(), wait_ticks);
+
+    CriticalSectionTrace::reset();
+    EXPECT_EQ(0u, CriticalSectionTrace::histogram(3).count());
+    EXPECT_EQ(0u, CriticalSectionTrace::histogram(4).count());
+}
+
+TEST_F(TestCriticalSectionTrace, traced_buffer_charges_every_operation_to_its_site)
+{
+    char pool[4];
+    CircularBuffer2<char, CircularBuffer2TracedCriticalSection<5> > buf(pool, sizeof(pool));
+    char c = 0;
+
+    EXPECT_TRUE(buf.push('a'));
+    EXPECT_TRUE(buf.pop(c));
+    EXPECT_EQ(2u, CriticalSectionTrace::histogram(5).count());
+}
+
+TEST_F(TestCriticalSectionTrace, port_sections_are_tagged_by_call_site)
+{
+    char rx_buf[16];
+    char tx_buf[16];
+    char buffer[4];
+    BufferedSerial2 port(NC, NC, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf));
+
+    EXPECT_EQ(3, port.write("abc", 3));
+    FakeHal::transmit();
+    EXPECT_EQ(2u, FakeHal::receive("xy", 2));
+    EXPECT_EQ(2, port.read(buffer, sizeof(buffer)));
+    port.set_rx_notify(1);
+
+    EXPECT_NE(0u, CriticalSectionTrace::histogram(BufferedSerial2TraceTxBuffer).count());
+    EXPECT_NE(0u, CriticalSectionTrace::histogram(BufferedSerial2TraceRxBuffer).count());
+    EXPECT_NE(0u, CriticalSectionTrace::histogram(BufferedSerial2TraceTxPrime).count());
+    EXPECT_EQ(1u, CriticalSectionTrace::histogram(BufferedSerial2TraceSettings).count());
+    EXPECT_EQ(0u, CriticalSectionTrace::histogram(BufferedSerial2TraceTxDma).count());
+    EXPECT_EQ("abc", FakeHal::take_line());
+}
@@ -0,0 +1,101 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2015-2019 ARM Limited
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "LatencyHistogram.h"
+
+using namespace mbed;
+
+TEST(TestLatencyHistogram, nothing_recorded_reads_0)
+{
+    LatencyHistogram<> histogram;
+
+    EXPECT_EQ(0u, histogram.count());
+    EXPECT_EQ(0u, histogram.max());
+    EXPECT_EQ(0u, histogram.total());
+    EXPECT_EQ(0u, histogram.percentile(500000));
+    EXPECT_EQ(0u, histogram.percentile(1000000));
+}
+
+TEST(TestLatencyHistogram, small_values_are_exact)
+{
+    LatencyHistogram<> histogram;
+
+    for (uint32_t value = 0; value < LatencyHistogram<>::sub_buckets; value++) {
+        histogram.record(value);
+    }
+    EXPECT_EQ(8u, histogram.count());
+    EXPECT_EQ(7u, histogram.max());
+    EXPECT_EQ(28u, histogram.total());
+    EXPECT_EQ(0u, histogram.percentile(0));
+    EXPECT_EQ(3u, histogram.percentile(500000));
+    EXPECT_EQ(6u, histogram.percentile(870000));
+    EXPECT_EQ(7u, histogram.percentile(1000000));
+}
+
+TEST(TestLatencyHistogram, percentiles_round_up_to_the_end_of_the_bucket)
+{
+    LatencyHistogram<> histogram;
+
+    for (uint32_t value = 1; value <= 100; value++) {
+        histogram.record(value);
+    }
+    // 50 is in [48, 51], 99 in [96, 103] which the largest value caps
+    EXPECT_EQ(51u, histogram.percentile(500000));
+    EXPECT_EQ(100u, histogram.percentile(990000));
+    EXPECT_EQ(100u, histogram.max());
+    EXPECT_EQ(5050u, histogram.total());
+}
+
+TEST(TestLatencyHistogram, relative_error_follows_the_precision)
+{
+    LatencyHistogram<> fine;
+    LatencyHistogram<1> coarse;
+
+    // 1000 is in [960, 1023] with 8 buckets per power of two, in [768, 1023] with 2
+    fine.record(1000);
+    fine.record(5000);
+    coarse.record(800);
+    coarse.record(5000);
+    EXPECT_EQ(1023u, fine.percentile(500000));
+    EXPECT_EQ(1023u, coarse.percentile(500000));
+    EXPECT_EQ(5000u, fine.percentile(1000000));
+}
+
+TEST(TestLatencyHistogram, the_full_32_bit_range_has_buckets)
+{
+    LatencyHistogram<> histogram;
+
+    histogram.record(UINT32_MAX);
+    histogram.record(UINT32_MAX);
+    EXPECT_EQ(UINT32_MAX, histogram.percentile(500000));
+    EXPECT_EQ(UINT32_MAX, histogram.max());
+    EXPECT_EQ(2ull * UINT32_MAX, histogram.total());
+}
+
+TEST(TestLatencyHistogram, reset_forgets_everything)
+{
+    LatencyHistogram<> histogram;
+
+    histogram.record(12345);
+    histogram.reset();
+    EXPECT_EQ(0u, histogram.count());
+    EXPECT_EQ(0u, histogram.max());
+    EXPECT_EQ(0u, histogram.percentile(500000));
+    histogram.record(3);
+    EXPECT_EQ(3u, histogram.percentile(500000));
+}